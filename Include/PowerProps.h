@@ -33,8 +33,6 @@
 
 #pragma once
 
-// If you use the static library version of GenIO, you must define GENIO_STATIC in your project's preprocessor definitions
-
 #if !defined(POWERPROPS_STATIC)
 
 #ifdef POWERPROPS_EXPORTS
@@ -367,6 +365,8 @@ namespace props
 			SM_BIN_VALUESONLY = 0,	/// id, type, value
 			SM_BIN_TERSE,			/// id, type, aspect, value
 			SM_BIN_VERBOSE,			/// name, id, type, aspect, value
+			SM_BIN_COMPACT,			/// id, type and aspect packed together, value; integers are varints, strings UTF-8 and booleans bits (whole sets only)
+			SM_BIN_ALIGNED,			/// id, type, aspect, value; padded so ids and values lie on their natural boundaries from the start of the set (whole sets only)
 
 			SM_NUMMODES
 		};
@@ -428,6 +428,8 @@ namespace props
 		virtual PROPERTY_TYPE GetType() const = NULL;
 
 		/// Allows you to convert a property from one type to another
+		/// A string is read as the new type; if it doesn't hold exactly one value of it, the conversion still happens
+		/// (anything missing or malformed becomes 0) but false is returned
 		virtual bool ConvertTo(PROPERTY_TYPE newtype) = NULL;
 
 		/// Aspect accessor methods
@@ -454,6 +456,8 @@ namespace props
 
 		/// Returns the data in the requested form.
 		/// If the internal type does not match the type requested, a more complicated operation may happen under the hood
+		/// AsString writes numbers in the fewest digits that read back as the same value, whatever the locale, and
+		/// strings are read back the same way; vectors and matrices as comma-separated lists
 		virtual int64_t AsInt(int64_t *ret = nullptr) const = NULL;
 		virtual const TVec2I *AsVec2I(TVec2I *ret = nullptr) const = NULL;
 		virtual const TVec3I *AsVec3I(TVec3I *ret = nullptr) const = NULL;
@@ -516,12 +520,137 @@ namespace props
 	};
 
 
+	/// Refers to a property within a set; unlike an index, a handle keeps referring to the same property while others are
+	/// deleted, and once its own property is deleted the set recognizes the handle as stale rather than returning another property
+	struct PropertyHandle
+	{
+		uint32_t index;
+		uint32_t generation;		/// never 0 for a valid handle, so a zeroed handle refers to nothing
+	};
+
+
+	/// Implement an IDataSink to receive binary serialized data as it's produced
+	class IDataSink
+	{
+
+	public:
+
+		/// Appends size bytes to whatever the sink writes to; returning false aborts serialization
+		virtual bool Write(const void *data, size_t size) = NULL;
+
+	};
+
+
+	/// Implement an IDataSource to supply binary serialized data to a reader as it's needed
+	class IDataSource
+	{
+
+	public:
+
+		/// Copies up to size bytes into data and returns the number copied; 0 means the data is exhausted (or unreadable)
+		virtual size_t Read(void *data, size_t size) = NULL;
+
+	};
+
+
+	/// A growable, in-memory IDataSink
+	class IDataBuffer : public IDataSink
+	{
+
+	public:
+
+		/// Frees the buffer
+		virtual void Release() = NULL;
+
+		/// Returns everything written so far
+		virtual const uint8_t *GetData() const = NULL;
+
+		/// Returns the number of bytes written so far
+		virtual size_t GetSize() const = NULL;
+
+		/// Empties the buffer, keeping its memory for reuse
+		virtual void Reset() = NULL;
+
+		/// Creates an empty buffer with room for reserve bytes before it needs to grow
+		POWERPROPS_API static IDataBuffer *CreateDataBuffer(size_t reserve = 0);
+
+	};
+
+
+	/// An IDataSink that writes to a file, through a buffer
+	class IFileSink : public IDataSink
+	{
+
+	public:
+
+		/// Closes the file if Close hasn't, then frees the sink; a failure to write what was still buffered goes unreported
+		virtual void Release() = NULL;
+
+		/// Writes anything still buffered and closes the file, returning false if any of it couldn't be written. Write only
+		/// reports whether data reached the buffer, so check this before trusting the file; writes after it fail
+		virtual bool Close() = NULL;
+
+		/// Creates (or truncates) the named file and returns a sink that writes to it, or nullptr if it can't be opened
+		POWERPROPS_API static IFileSink *CreateFileSink(const TCHAR *filename);
+
+	};
+
+
+	/// Implement an IPropertyCodec to compress serialized property sets; see IPropertySet::SerializeCompressed
+	class IPropertyCodec
+	{
+
+	public:
+
+		/// Returns an id that's stored with the compressed data, so it can't be decompressed by the wrong codec
+		virtual uint32_t GetID() const = NULL;
+
+		/// Compresses size bytes of data to the sink
+		virtual bool Compress(const void *data, size_t size, IDataSink *psink) = NULL;
+
+		/// Decompresses size bytes of data into dst, which must be filled exactly; fails on corrupt data rather than
+		/// reading or writing out of bounds
+		virtual bool Decompress(const void *data, size_t size, void *dst, size_t dstsize) = NULL;
+
+		/// Returns the most bytes that one byte of compressed data can decompress to (at least 1); data claiming to
+		/// expand further than that is rejected as corrupt before any memory is allocated for it
+		virtual size_t GetMaxRatio() const = NULL;
+
+		/// Returns the built-in codec, a fast LZ77 with no external dependencies; it's stateless and may be shared
+		POWERPROPS_API static IPropertyCodec *GetLZCodec();
+
+	};
+
+
 	/// IPropertySet is a container for IProperty instances, 
 	class IPropertySet
 	{
 
 	public:
 
+		/// How a property set allocates its properties and their names and string values
+		enum ALLOCATION_MODE
+		{
+			AM_HEAP = 0,		/// each property and string is allocated individually from the heap
+			AM_ARENA,			/// properties and strings are carved from slabs owned by the set and freed in bulk by DeleteAll / Release
+
+			AM_NUMMODES
+		};
+
+		/// Describes one property for CreateProperties
+		struct SPropertyDesc
+		{
+			const TCHAR *name;
+			FOURCHARCODE id;
+			IProperty::PROPERTY_TYPE type;
+			IProperty::PROPERTY_ASPECT aspect;
+			uint32_t flags;						/// IProperty::PROPFLAG bits, applied after the value so locking flags are fine
+
+			/// Points at the initial value in the type's own layout (int64_t, float, TVec3F, GUID, bool, etc.), except that a PT_STRING
+			/// value is the string itself and a PT_ENUM value is its comma-delimited list of strings. nullptr means zero or empty
+			const void *value;
+		};
+
 		/// Releases any resources the property set may have allocated
 		virtual void Release() = NULL;
 
@@ -531,7 +660,12 @@ namespace props
 		/// Creates a property that references data held elsewhere and adds it to this property set (only bool, number, guid, and vector types supported)
 		virtual IProperty *CreateReferenceProperty(const TCHAR *propname, FOURCHARCODE propid, void *addr, IProperty::PROPERTY_TYPE type) = NULL;
 
-		/// Deletes a property from this set, based on a given index
+		/// Creates a property for each descriptor whose id isn't already in the set, using a single allocation for all of them (from the
+		/// set's arena under AM_ARENA); the listener isn't told about their initial values. Returns the number created. Deleting one of
+		/// these properties doesn't free its memory, which stays part of the batch's block until DeleteAll (or Release) frees it
+		virtual size_t CreateProperties(const SPropertyDesc *descs, size_t count) = NULL;
+
+		/// Deletes a property from this set, based on a given index; the last property moves into the vacated index
 		virtual void DeleteProperty(size_t idx) = NULL;
 
 		/// Deletes a property from this set, based on a given property id
@@ -540,6 +674,9 @@ namespace props
 		/// Deletes a property from this set, based on a given property name
 		virtual void DeletePropertyByName(const TCHAR *propname) = NULL;
 
+		/// Deletes the property a handle refers to; stale handles are ignored
+		virtual void DeletePropertyByHandle(PropertyHandle handle) = NULL;
+
 		/// Deletes all properties from this set
 		virtual void DeleteAll() = NULL;
 
@@ -555,6 +692,12 @@ namespace props
 		/// Gets a property from this set, given a property name
 		virtual IProperty *GetPropertyByName(const TCHAR *propname) const = NULL;
 
+		/// Returns a handle to the property with the given id, or a zeroed handle if there is no such property
+		virtual PropertyHandle GetPropertyHandle(FOURCHARCODE propid) const = NULL;
+
+		/// Gets the property a handle refers to, or nullptr if that property has since been deleted
+		virtual IProperty *GetPropertyByHandle(PropertyHandle handle) const = NULL;
+
 		/// Indexing gets a property from this set, given a property id (FOURCHARCODE) or name (const TCHAR *)
 		virtual IProperty * operator[](FOURCHARCODE propid) const = NULL;
 		virtual IProperty * operator[](const TCHAR *propname) const = NULL;
@@ -565,32 +708,245 @@ namespace props
 		/// Writes all properties to a binary stream
 		/// If buf is null but amountused is not, the number of bytes required to fully
 		/// store the property set will be placed at amountused
+		/// SM_BIN_VALUESONLY, SM_BIN_TERSE and SM_BIN_VERBOSE fail for sets of more than 32767 properties;
+		/// use SM_BIN_COMPACT or SerializeChunked for those
 		virtual bool Serialize(IProperty::SERIALIZE_MODE mode, uint8_t *buf, size_t bufsize, size_t *amountused = NULL) const = NULL;
 
+		/// Writes all properties to a sink in a single pass, in the same format as above; no size needs to be known up front
+		virtual bool Serialize(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const = NULL;
+
 		/// Reads all properties from a binary stream
 		/// If successful, the return value will be true and the number of bytes
 		/// consumed will be reported, if desired
 		virtual bool Deserialize(uint8_t *buf, size_t bufsize, size_t *bytesconsumed) = NULL;
 
+		/// Writes all properties to a sink as a stream of chunks of about chunksize bytes, each holding at most 32767 properties
+		/// in the given mode, so there is no limit on the number of properties and only one chunk is ever held in memory.
+		/// No chunk is ever larger than 64MB (chunksize is capped at half that), so a single property too big to fit fails it
+		virtual bool SerializeChunked(IProperty::SERIALIZE_MODE mode, IDataSink *psink, size_t chunksize = (64 << 10)) const = NULL;
+
+		/// Reads a stream written by SerializeChunked, one chunk at a time; a chunk claiming to be larger than 64MB fails it
+		virtual bool DeserializeChunked(IDataSource *psource) = NULL;
+
+		/// Serializes the set in the given mode and compresses it with pcodec, or with the built-in LZ codec if pcodec is null
+		virtual bool SerializeCompressed(IProperty::SERIALIZE_MODE mode, IPropertyCodec *pcodec, IDataSink *psink) const = NULL;
+
+		/// Reads a set written by SerializeCompressed; pcodec must be the same kind of codec it was written with
+		virtual bool DeserializeCompressed(const uint8_t *buf, size_t bufsize, IPropertyCodec *pcodec = nullptr, size_t *bytesconsumed = nullptr) = NULL;
+
+		/// Writes the set as an archive: an index of every property's id, type and location, sorted by id, followed by the
+		/// properties themselves in SM_BIN_VERBOSE form. IPropertySetView::OpenPropertyArchive maps the result and reads
+		/// only the properties that are asked for. Archives are limited to 4GB
+		virtual bool SerializeArchive(IDataSink *psink) const = NULL;
+
+		/// Returns a checkpoint marking the set's current state, to pass to SerializeDelta later
+		/// Deletions are only recorded from the first call on, so get a checkpoint before relying on deltas
+		virtual uint64_t GetCheckpoint() const = NULL;
+
+		/// Writes only what has changed since the given checkpoint: deleted properties' ids and the created or changed properties.
+		/// A checkpoint of 0 writes every property. Applying the delta to a copy of the set as it was at the checkpoint brings it up to date
+		virtual bool SerializeDelta(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const = NULL;
+
+		/// Reads a delta written by SerializeDelta, deleting, creating and updating properties as it describes
+		virtual bool ApplyDelta(uint8_t *buf, size_t bufsize, size_t *bytesconsumed = NULL) = NULL;
+
+		/// Forgets deletions made at or before the given checkpoint, which every receiver is known to have seen; deltas from
+		/// older checkpoints will no longer report them
+		virtual void TrimDeltaHistory(uint64_t checkpoint) = NULL;
+
 		/// <summary>
 		/// Writes all properties to an XML-formatted tstring in the verbose equivalent
 		/// </summary>
 		/// <param name="xmls">When the return value is true, will contain the XML fragment that represents all properties in the set</param>
 		virtual bool SerializeToXMLString(IProperty::SERIALIZE_MODE mode, tstring &xmls) const = NULL;
 
+		/// Writes the same XML as SerializeToXMLString, as TCHARs, to a sink in fixed-size pieces as it's generated, so
+		/// the document never has to be held in memory
+		virtual bool SerializeToXML(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const = NULL;
+
 		/// <summary>
 		/// Reads all properties from an XML-formatted tstring
 		/// </summary>
 		/// <param name="xmls">an XML fragment that contains property data</param>
 		virtual bool DeserializeFromXMLString(const tstring &xmls) = NULL;
 
+		/// Writes all properties, as TCHARs, to a sink as a JSON document: {"property_set": [...]}, with an object for each
+		/// property that holds its id, type and value, its aspect and flags (when set) from SM_BIN_TERSE up and its name in
+		/// SM_BIN_VERBOSE. Vectors are arrays, matrices are arrays of rows and numbers use the fewest digits that read back exactly
+		virtual bool SerializeToJSON(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const = NULL;
+
+		/// Writes the same JSON as SerializeToJSON to a tstring
+		virtual bool SerializeToJSONString(IProperty::SERIALIZE_MODE mode, tstring &jsons) const = NULL;
+
+		/// Reads properties from a JSON document in the form SerializeToJSON writes, creating any the set doesn't have
+		virtual bool DeserializeFromJSON(const tstring &jsons) = NULL;
+
 		/// Register a change listener if you want to know when a property has changed
 		virtual void SetChangeListener(const IPropertyChangeListener *plistener) = NULL;
 
 		/// Creates an instance of the IPropertySet interface, allowing the user to add IProperty's to it
 		/// These can be serialized to a packet and distributed to a set of listeners. Imagination is the only limitation.
 		/// (Only included as an example, use or not, with discretion)
-		POWERPROPS_API static IPropertySet *CreatePropertySet();
+		/// Sets that are built up and torn down often (per-frame entity state, for example) should use AM_ARENA
+		POWERPROPS_API static IPropertySet *CreatePropertySet(ALLOCATION_MODE mode = AM_HEAP);
+
+		/// Property names are interned in a pool shared by every property set in the process
+		struct SNamePoolStats
+		{
+			size_t UniqueNames;		/// the number of distinct names in the pool
+			size_t References;		/// the number of properties using a pooled name
+			size_t PooledBytes;		/// the memory used by the pool
+			size_t UnpooledBytes;	/// the memory the same names would use if every property kept its own copy
+		};
+
+		/// Reports how much memory the name pool is using and how much it saves
+		POWERPROPS_API static void GetNamePoolStats(SNamePoolStats *stats);
+
+		/// Writes many sets that have the same properties (the same ids and types, in any order) as one batch: each property's
+		/// id, type, aspect, name and enum strings are written once, as the first set's mode serialization, followed by that
+		/// property's value in every set, one column at a time. SM_BIN_COMPACT isn't supported. Fails, writing nothing, if any
+		/// set's properties differ from the first's
+		POWERPROPS_API static bool SerializeBatch(const IPropertySet * const *sets, size_t numsets, IProperty::SERIALIZE_MODE mode, IDataSink *psink);
+
+		/// Reads a batch written by SerializeBatch into sets, creating any properties they're missing; null entries are filled
+		/// with new sets. If sets is null or maxsets is smaller than the batch, this returns false and numsets receives the
+		/// number of sets needed
+		POWERPROPS_API static bool DeserializeBatch(const uint8_t *buf, size_t bufsize, IPropertySet **sets, size_t maxsets, size_t *numsets, size_t *bytesconsumed = nullptr);
+
+		/// Writes many independent sets, which may have different properties, as one archive: a table of where each set
+		/// starts, then each set as Serialize writes it in the given mode
+		POWERPROPS_API static bool SerializeMulti(const IPropertySet * const *sets, size_t numsets, IProperty::SERIALIZE_MODE mode, IDataSink *psink);
+
+		/// Reads an archive written by SerializeMulti, deserializing its sets concurrently on up to numthreads threads
+		/// (0 means one per hardware thread). sets, maxsets and numsets work as they do for DeserializeBatch. The sets
+		/// must not be used elsewhere until this returns, and their change listeners are called from the worker threads
+		POWERPROPS_API static bool DeserializeMulti(const uint8_t *buf, size_t bufsize, IPropertySet **sets, size_t maxsets, size_t *numsets, size_t numthreads = 0, size_t *bytesconsumed = nullptr);
+
+	};
+
+
+	/// IPropertySchema describes the names, ids, types, aspects, flags and enum strings of a group of properties once,
+	/// so that any number of property sets sharing that shape only need to store their values.
+	class IPropertySchema
+	{
+
+	public:
+
+		/// Releases the caller's reference; the schema lives on until every set created from it has been released
+		virtual void Release() = NULL;
+
+		/// Returns the number of properties the schema describes
+		virtual size_t GetPropertyCount() const = NULL;
+
+		/// Returns the size, in bytes, of the value block each set created from this schema stores
+		virtual size_t GetValueSize() const = NULL;
+
+		/// Creates a property set with this schema's shape, holding the prototype's values.
+		/// Its properties are fixed: creating, deleting, renaming and changing the id, type, aspect or enum strings of them
+		/// is ignored, and flags are shared by every set using the schema. Values set as another type are converted.
+		virtual IPropertySet *CreatePropertySet() = NULL;
+
+		/// Creates a schema from the properties in prototype, whose current values become the defaults for new sets
+		POWERPROPS_API static IPropertySchema *CreatePropertySchema(const IPropertySet *prototype);
+
+	};
+
+
+	/// IPropertyTable stores many rows of properties that share a schema, column by column: each property's values for every
+	/// row are kept in one contiguous array, so a bulk pass over one property touches only that array.
+	class IPropertyTable
+	{
+
+	public:
+
+		/// Releases the caller's reference; the table lives on until every row view created from it has been released
+		virtual void Release() = NULL;
+
+		/// Returns the number of rows in the table
+		virtual size_t GetRowCount() const = NULL;
+
+		/// Appends count rows holding the schema's default values and returns the index of the first one
+		virtual size_t AddRows(size_t count) = NULL;
+
+		/// Removes a row by moving the last row into its place
+		virtual void RemoveRow(size_t row) = NULL;
+
+		/// Removes every row
+		virtual void RemoveAllRows() = NULL;
+
+		/// Creates a property set that reads and writes the given row in place, for code that works with IPropertySet.
+		/// Release it when done. It refers to its row by index, so removing rows changes which row it sees; once that index
+		/// is past the last row, the view has no properties, any it handed out read as empty and ignore writes, and it
+		/// can't be serialized or deserialized
+		virtual IPropertySet *CreateRowView(size_t row) = NULL;
+
+		/// Returns the given property's values for every row as a contiguous array of GetRowCount() elements of its type
+		/// (int64_t for PT_INT, uint64_t for PT_ENUM, TVec3F for PT_FLOAT_V3, const TCHAR * for PT_STRING, etc.), or nullptr
+		/// if the schema has no such property. Adding or removing rows may move the array. Values written through it aren't
+		/// reported to any change listener, and strings should only be changed through a row view.
+		virtual void *GetColumn(FOURCHARCODE propid, IProperty::PROPERTY_TYPE *type = nullptr) = NULL;
+
+		/// Creates an empty table whose rows have the shape of the given schema
+		POWERPROPS_API static IPropertyTable *CreatePropertyTable(IPropertySchema *schema);
+
+	};
+
+
+	/// IPropertySetView reads a buffer written by IPropertySet::Serialize (in any mode but SM_BIN_COMPACT) in place, without creating any properties.
+	/// With SM_BIN_ALIGNED, the values it returns pointers to are properly aligned as long as the buffer starts on an 8-byte boundary. Nothing is
+	/// copied or converted: strings and vectors are returned as pointers into the buffer (which may not be aligned), and asking
+	/// for a type other than the one stored returns 0 or nullptr. The buffer must stay alive and unchanged while the view is used.
+	class IPropertySetView
+	{
+
+	public:
+
+		/// Frees the view, but not the buffer
+		virtual void Release() = NULL;
+
+		/// Returns the number of properties in the buffer
+		virtual size_t GetPropertyCount() const = NULL;
+
+		/// Return the index of the property with the given id or name, or -1 if there is none; only SM_BIN_VERBOSE stores names
+		virtual size_t FindById(FOURCHARCODE propid) const = NULL;
+		virtual size_t FindByName(const TCHAR *propname) const = NULL;
+
+		/// Describe the property at the given index. GetName returns nullptr unless it was written with SM_BIN_VERBOSE, and
+		/// GetAspect returns PA_GENERIC for anything written with SM_BIN_VALUESONLY
+		virtual FOURCHARCODE GetID(size_t idx) const = NULL;
+		virtual const TCHAR *GetName(size_t idx) const = NULL;
+		virtual IProperty::PROPERTY_TYPE GetType(size_t idx) const = NULL;
+		virtual IProperty::PROPERTY_ASPECT GetAspect(size_t idx) const = NULL;
+
+		/// Return the value at the given index if it has the matching type; AsInt also returns the value of a PT_ENUM
+		virtual int64_t AsInt(size_t idx) const = NULL;
+		virtual const TVec2I *AsVec2I(size_t idx) const = NULL;
+		virtual const TVec3I *AsVec3I(size_t idx) const = NULL;
+		virtual const TVec4I *AsVec4I(size_t idx) const = NULL;
+		virtual float AsFloat(size_t idx) const = NULL;
+		virtual const TVec2F *AsVec2F(size_t idx) const = NULL;
+		virtual const TVec3F *AsVec3F(size_t idx) const = NULL;
+		virtual const TVec4F *AsVec4F(size_t idx) const = NULL;
+		virtual const TCHAR *AsString(size_t idx) const = NULL;
+		virtual const GUID *AsGUID(size_t idx) const = NULL;
+		virtual bool AsBool(size_t idx) const = NULL;
+		virtual const TMat3x3F *AsMat3x3F(size_t idx) const = NULL;
+		virtual const TMat4x4F *AsMat4x4F(size_t idx) const = NULL;
+
+		/// Returns the comma-delimited strings of a PT_ENUM
+		virtual const TCHAR *GetEnumStrings(size_t idx) const = NULL;
+
+		/// Validates the buffer and creates a view of it, or returns nullptr if it doesn't hold a complete serialized property set.
+		/// If bytesconsumed is given, it receives the size of the serialized set
+		POWERPROPS_API static IPropertySetView *CreatePropertySetView(const uint8_t *buf, size_t bufsize, size_t *bytesconsumed = nullptr);
+
+		/// Creates a view of an archive written by IPropertySet::SerializeArchive. Only the index is validated up front;
+		/// FindById searches the index and each property is parsed when it's read, so the cost follows what is actually
+		/// used. FindByName has to visit every property. The buffer must outlive the view
+		POWERPROPS_API static IPropertySetView *CreateArchiveView(const uint8_t *buf, size_t bufsize);
+
+		/// Maps an archive file into memory and creates a view of it, as CreateArchiveView; Release unmaps it
+		POWERPROPS_API static IPropertySetView *OpenPropertyArchive(const TCHAR *filename);
 
 	};
 
@@ -0,0 +1,249 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// AlignedEncoding.h : the primitives behind SM_BIN_ALIGNED
+//
+// Records are laid out as in SM_BIN_TERSE, less the mode byte, but padding is inserted ahead of every
+// id and value so that each lies on its natural boundary, measured from the start of the set. When the
+// set itself starts on an 8-byte boundary, its values can be used where they lie, and the reader never
+// depends on it doing so. Every value still follows its own id, type and aspect, so values of the same
+// type aren't contiguous and are read one at a time.
+//
+// An aligned set begins with a short of -5, which no other serialized set can start with, two bytes of
+// padding and a 32-bit property count.
+
+#pragma once
+
+
+class CAlignedWriter
+{
+protected:
+	props::IDataSink *m_pSink;
+	bool m_OK;
+
+	// how far into the set the next byte goes
+	size_t m_Pos;
+
+public:
+	enum { HEADER_SIZE = sizeof(short) + sizeof(uint16_t) + sizeof(uint32_t) };
+
+	CAlignedWriter(props::IDataSink *psink, size_t pos = 0)
+	{
+		m_pSink = psink;
+		m_OK = (psink != nullptr);
+		m_Pos = pos;
+	}
+
+	bool OK() const { return m_OK; }
+
+	// for writers whose sink has been emptied and now starts over at pos
+	void Restart(size_t pos)
+	{
+		m_Pos = pos;
+	}
+
+	bool WriteRaw(const void *data, size_t size)
+	{
+		if (m_OK)
+			m_OK = m_pSink->Write(data, size);
+
+		m_Pos += size;
+
+		return m_OK;
+	}
+
+	// zero-fills up to the next multiple of align, which must be a power of two
+	bool Pad(size_t align)
+	{
+		static const uint8_t zeros[16] = { 0 };
+
+		size_t pad = (align - (m_Pos & (align - 1))) & (align - 1);
+		return !pad || WriteRaw(zeros, pad);
+	}
+
+	bool WriteAligned(const void *data, size_t size, size_t align)
+	{
+		return Pad(align) && WriteRaw(data, size);
+	}
+
+	void WriteByte(uint8_t b)
+	{
+		WriteRaw(&b, sizeof(uint8_t));
+	}
+
+	// strings keep their terminator and are aligned for TCHAR
+	void WriteString(const TCHAR *s)
+	{
+		if (!s)
+			s = _T("");
+
+		WriteAligned(s, sizeof(TCHAR) * (_tcslen(s) + 1), sizeof(TCHAR));
+	}
+
+	bool BeginSet(size_t count)
+	{
+		short marker = -5;
+		uint16_t pad = 0;
+		uint32_t n = uint32_t(count);
+
+		return WriteRaw(&marker, sizeof(short)) && WriteRaw(&pad, sizeof(uint16_t)) && WriteRaw(&n, sizeof(uint32_t));
+	}
+};
+
+
+class CAlignedReader
+{
+protected:
+	const uint8_t *m_pStart, *m_p, *m_pEnd;
+	bool m_OK;
+
+	// the most recently read string, when it couldn't be used in place
+	tstring m_Str;
+
+public:
+	CAlignedReader(const uint8_t *buf, size_t bufsize)
+	{
+		m_pStart = m_p = buf;
+		m_pEnd = buf + bufsize;
+		m_OK = (buf != nullptr);
+	}
+
+	/// True if buf holds an aligned set rather than one of the other binary modes
+	static bool IsAlignedSet(const uint8_t *buf, size_t bufsize)
+	{
+		short marker;
+		if (!buf || (bufsize < sizeof(short)))
+			return false;
+
+		memcpy(&marker, buf, sizeof(short));
+		return (marker == -5);
+	}
+
+	bool OK() const { return m_OK; }
+
+	size_t GetConsumed() const { return (m_p - m_pStart); }
+
+	// skips the padding before a value of the given alignment and size, returning where the value is, or nullptr
+	// if the buffer ends first
+	const uint8_t *Take(size_t size, size_t align)
+	{
+		size_t pos = (m_p - m_pStart);
+		size_t pad = (align - (pos & (align - 1))) & (align - 1);
+
+		if (!m_OK || ((size_t)(m_pEnd - m_p) < pad) || ((size_t)(m_pEnd - m_p - pad) < size))
+		{
+			m_OK = false;
+			return nullptr;
+		}
+
+		const uint8_t *ret = m_p + pad;
+		m_p = ret + size;
+
+		return ret;
+	}
+
+	bool ReadAligned(void *data, size_t size, size_t align)
+	{
+		const uint8_t *p = Take(size, align);
+		if (!p)
+		{
+			memset(data, 0, size);
+			return false;
+		}
+
+		memcpy(data, p, size);
+		return true;
+	}
+
+	uint8_t ReadByte()
+	{
+		uint8_t b = 0;
+		ReadAligned(&b, sizeof(uint8_t), 1);
+		return b;
+	}
+
+	// finds the string at the next TCHAR boundary, returning where it is and its size with the terminator
+	const uint8_t *TakeString(size_t *size)
+	{
+		if (!Take(0, sizeof(TCHAR)))
+			return nullptr;
+
+		for (const uint8_t *s = m_p; (s + sizeof(TCHAR)) <= m_pEnd; s += sizeof(TCHAR))
+		{
+			TCHAR c;
+			memcpy(&c, s, sizeof(TCHAR));
+			if (!c)
+			{
+				const uint8_t *ret = m_p;
+
+				*size = (s - m_p) + sizeof(TCHAR);
+				m_p = s + sizeof(TCHAR);
+
+				return ret;
+			}
+		}
+
+		m_OK = false;
+		return nullptr;
+	}
+
+	// the string is used in place if the buffer's alignment allows it, and copied otherwise
+	const TCHAR *ReadString()
+	{
+		size_t sz;
+		const uint8_t *p = TakeString(&sz);
+		if (!p)
+			return nullptr;
+
+		if (!((uintptr_t)p & (sizeof(TCHAR) - 1)))
+			return (const TCHAR *)p;
+
+		m_Str.resize((sz / sizeof(TCHAR)) - 1);
+		memcpy(&m_Str[0], p, sz - sizeof(TCHAR));
+
+		return m_Str.c_str();
+	}
+
+	bool BeginSet(size_t *count)
+	{
+		short marker;
+		uint16_t pad;
+		uint32_t n = 0;
+
+		if (!ReadAligned(&marker, sizeof(short), 1) || !ReadAligned(&pad, sizeof(uint16_t), 1) || !ReadAligned(&n, sizeof(uint32_t), 1) || (marker != -5))
+			m_OK = false;
+
+		*count = n;
+
+		return m_OK;
+	}
+};
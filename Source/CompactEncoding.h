@@ -0,0 +1,392 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// CompactEncoding.h : the primitives behind SM_BIN_COMPACT
+//
+// Unsigned integers are written as LEB128 varints, and signed ones are zig-zagged first so that small
+// magnitudes of either sign take a byte or two. Strings are a varint byte count followed by UTF-8,
+// however TCHAR is defined. Booleans are collected by the writer and written as one bit array at the
+// end of the set.
+//
+// A compact set begins with a short of -1, which no other serialized set can start with, then the mode
+// byte and a varint property count.
+
+#pragma once
+
+
+class CCompactWriter
+{
+protected:
+	props::IDataSink *m_pSink;
+	bool m_OK;
+
+	// small writes are gathered here so the sink sees a few large ones
+	uint8_t m_Buf[256];
+	size_t m_Used;
+
+	::std::vector<uint8_t> m_Bools;
+	size_t m_NumBools;
+
+	void Put(uint8_t b)
+	{
+		if (m_Used == sizeof(m_Buf))
+			Flush();
+
+		m_Buf[m_Used++] = b;
+	}
+
+	// the code point starting at s, advancing s past it; UTF-16 surrogate pairs are combined
+	static uint32_t NextCodePoint(const TCHAR *&s)
+	{
+		uint32_t c = (uint32_t)*(s++);
+
+		if ((c >= 0xD800) && (c < 0xDC00) && ((uint32_t)*s >= 0xDC00) && ((uint32_t)*s < 0xE000))
+			c = 0x10000 + ((c - 0xD800) << 10) + ((uint32_t)*(s++) - 0xDC00);
+
+		return c;
+	}
+
+	static size_t Utf8Size(uint32_t c)
+	{
+		return (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+	}
+
+public:
+	CCompactWriter(props::IDataSink *psink)
+	{
+		m_pSink = psink;
+		m_OK = (psink != nullptr);
+		m_Used = 0;
+		m_NumBools = 0;
+	}
+
+	bool Flush()
+	{
+		if (m_Used && m_OK)
+			m_OK = m_pSink->Write(m_Buf, m_Used);
+
+		m_Used = 0;
+
+		return m_OK;
+	}
+
+	void WriteByte(uint8_t b)
+	{
+		Put(b);
+	}
+
+	void WriteVarint(uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			Put(uint8_t(v) | 0x80);
+			v >>= 7;
+		}
+
+		Put(uint8_t(v));
+	}
+
+	void WriteSigned(int64_t v)
+	{
+		WriteVarint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+	}
+
+	void WriteRaw(const void *data, size_t size)
+	{
+		if (size > (sizeof(m_Buf) - m_Used))
+		{
+			Flush();
+
+			if (size > sizeof(m_Buf))
+			{
+				if (m_OK)
+					m_OK = m_pSink->Write(data, size);
+				return;
+			}
+		}
+
+		memcpy(m_Buf + m_Used, data, size);
+		m_Used += size;
+	}
+
+	void WriteString(const TCHAR *s)
+	{
+		if (!s)
+			s = _T("");
+
+#if defined(_UNICODE)
+		// the byte count comes first, so measure before encoding
+		size_t len = 0;
+		for (const TCHAR *m = s; *m; )
+			len += Utf8Size(NextCodePoint(m));
+
+		WriteVarint(len);
+
+		while (*s)
+		{
+			uint32_t c = NextCodePoint(s);
+
+			if (c < 0x80)
+			{
+				Put(uint8_t(c));
+			}
+			else if (c < 0x800)
+			{
+				Put(uint8_t(0xC0 | (c >> 6)));
+				Put(uint8_t(0x80 | (c & 0x3F)));
+			}
+			else if (c < 0x10000)
+			{
+				Put(uint8_t(0xE0 | (c >> 12)));
+				Put(uint8_t(0x80 | ((c >> 6) & 0x3F)));
+				Put(uint8_t(0x80 | (c & 0x3F)));
+			}
+			else
+			{
+				Put(uint8_t(0xF0 | (c >> 18)));
+				Put(uint8_t(0x80 | ((c >> 12) & 0x3F)));
+				Put(uint8_t(0x80 | ((c >> 6) & 0x3F)));
+				Put(uint8_t(0x80 | (c & 0x3F)));
+			}
+		}
+#else
+		// multibyte builds are assumed to hold UTF-8 already
+		size_t len = strlen(s);
+		WriteVarint(len);
+		WriteRaw(s, len);
+#endif
+	}
+
+	// booleans are held back and written together by EndSet
+	void WriteBool(bool b)
+	{
+		if (!(m_NumBools & 7))
+			m_Bools.push_back(0);
+
+		if (b)
+			m_Bools.back() |= uint8_t(1 << (m_NumBools & 7));
+
+		m_NumBools++;
+	}
+
+	void BeginSet(size_t count)
+	{
+		short marker = -1;
+		WriteRaw(&marker, sizeof(short));
+		WriteByte(uint8_t(props::IProperty::SM_BIN_COMPACT));
+		WriteVarint(count);
+	}
+
+	bool EndSet()
+	{
+		if (!m_Bools.empty())
+			WriteRaw(m_Bools.data(), m_Bools.size());
+
+		return Flush();
+	}
+
+	// forgets any booleans written so far, so the writer can start another set
+	void Restart()
+	{
+		m_Used = 0;
+		m_Bools.clear();
+		m_NumBools = 0;
+	}
+};
+
+
+class CCompactReader
+{
+protected:
+	const uint8_t *m_pStart, *m_p, *m_pEnd;
+	bool m_OK;
+
+	// the most recently read string; ReadString returns a pointer into it
+	tstring m_Str;
+
+	const uint8_t *m_pBools;
+
+public:
+	CCompactReader(const uint8_t *buf, size_t bufsize)
+	{
+		m_pStart = m_p = buf;
+		m_pEnd = buf + bufsize;
+		m_OK = (buf != nullptr);
+		m_pBools = nullptr;
+	}
+
+	/// True if buf holds a compact set rather than one of the other binary modes
+	static bool IsCompact(const uint8_t *buf, size_t bufsize)
+	{
+		short marker;
+		if (!buf || (bufsize < sizeof(short)))
+			return false;
+
+		memcpy(&marker, buf, sizeof(short));
+		return (marker == -1);
+	}
+
+	bool OK() const { return m_OK; }
+
+	size_t GetConsumed() const { return (m_p - m_pStart); }
+
+	uint8_t ReadByte()
+	{
+		if (m_p >= m_pEnd)
+		{
+			m_OK = false;
+			return 0;
+		}
+
+		return *(m_p++);
+	}
+
+	uint64_t ReadVarint()
+	{
+		uint64_t v = 0;
+
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t b = ReadByte();
+			v |= uint64_t(b & 0x7F) << shift;
+
+			if (!(b & 0x80))
+				return v;
+		}
+
+		m_OK = false;
+		return 0;
+	}
+
+	int64_t ReadSigned()
+	{
+		uint64_t v = ReadVarint();
+		return int64_t(v >> 1) ^ -int64_t(v & 1);
+	}
+
+	bool ReadRaw(void *data, size_t size)
+	{
+		if ((size_t)(m_pEnd - m_p) < size)
+		{
+			m_OK = false;
+			memset(data, 0, size);
+			return false;
+		}
+
+		memcpy(data, m_p, size);
+		m_p += size;
+
+		return true;
+	}
+
+	const TCHAR *ReadString()
+	{
+		m_Str.clear();
+
+		uint64_t len = ReadVarint();
+		if (!m_OK || ((uint64_t)(m_pEnd - m_p) < len))
+		{
+			m_OK = false;
+			return m_Str.c_str();
+		}
+
+		const uint8_t *s = m_p, *e = m_p + len;
+		m_p = e;
+
+#if defined(_UNICODE)
+		while (s < e)
+		{
+			uint32_t c = *(s++);
+			size_t more = (c < 0x80) ? 0 : ((c & 0xE0) == 0xC0) ? 1 : ((c & 0xF0) == 0xE0) ? 2 : ((c & 0xF8) == 0xF0) ? 3 : 4;
+			if ((more > 3) || ((size_t)(e - s) < more))
+			{
+				m_OK = false;
+				break;
+			}
+
+			if (more)
+				c &= (0x3F >> more);
+
+			for (; more; more--)
+				c = (c << 6) | (*(s++) & 0x3F);
+
+			if ((sizeof(TCHAR) == 2) && (c >= 0x10000))
+			{
+				c -= 0x10000;
+				m_Str += TCHAR(0xD800 + (c >> 10));
+				m_Str += TCHAR(0xDC00 + (c & 0x3FF));
+			}
+			else
+				m_Str += TCHAR(c);
+		}
+#else
+		m_Str.assign((const char *)s, (size_t)len);
+#endif
+
+		return m_Str.c_str();
+	}
+
+	bool BeginSet(size_t *count)
+	{
+		short marker;
+		ReadRaw(&marker, sizeof(short));
+
+		uint8_t mode = ReadByte();
+		if ((marker != -1) || (mode != props::IProperty::SM_BIN_COMPACT))
+			m_OK = false;
+
+		*count = (size_t)ReadVarint();
+
+		return m_OK;
+	}
+
+	// locates the bit array of count booleans that follows the records
+	bool BeginBools(size_t count)
+	{
+		size_t sz = (count + 7) / 8;
+		if ((size_t)(m_pEnd - m_p) < sz)
+			m_OK = false;
+
+		if (m_OK)
+		{
+			m_pBools = m_p;
+			m_p += sz;
+		}
+
+		return m_OK;
+	}
+
+	bool ReadBool(size_t idx) const
+	{
+		return ((m_pBools[idx >> 3] >> (idx & 7)) & 1) ? true : false;
+	}
+};
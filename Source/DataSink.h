@@ -0,0 +1,185 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// DataSink.h : the IDataSink implementations used for serialization
+//
+// Serialization always writes through a sink, in a single pass. CFixedDataSink adapts the
+// older caller-supplied buffer interface, CDataBuffer grows as data is appended, CStringDataSink
+// appends text to a tstring and CFileSink writes to a file.
+
+#pragma once
+
+
+// writes into a fixed buffer; once the data no longer fits, writing stops but counting continues,
+// so the caller still learns how many bytes would have been needed
+class CFixedDataSink : public props::IDataSink
+{
+protected:
+	uint8_t *m_pBuf;
+	size_t m_BufSize;
+	size_t m_Size;
+
+public:
+	CFixedDataSink(uint8_t *buf, size_t bufsize)
+	{
+		m_pBuf = buf;
+		m_BufSize = bufsize;
+		m_Size = 0;
+	}
+
+	virtual bool Write(const void *data, size_t size)
+	{
+		if (m_pBuf && ((m_Size + size) <= m_BufSize))
+			memcpy(m_pBuf + m_Size, data, size);
+		else
+			m_pBuf = nullptr;
+
+		m_Size += size;
+
+		return true;
+	}
+
+	/// The number of bytes written, or that would have been written had there been room
+	size_t GetSize() const { return m_Size; }
+
+	/// True if there was a buffer and everything written fit into it
+	bool Fits() const { return (m_pBuf != nullptr); }
+};
+
+
+class CDataBuffer final : public props::IDataBuffer
+{
+protected:
+	std::vector<uint8_t> m_Data;
+
+public:
+	CDataBuffer(size_t reserve)
+	{
+		m_Data.reserve(reserve);
+	}
+
+	virtual void Release()
+	{
+		delete this;
+	}
+
+	virtual bool Write(const void *data, size_t size)
+	{
+		const uint8_t *p = (const uint8_t *)data;
+
+		// running out of memory is reported like any other failed write, rather than thrown out of the library
+		try
+		{
+			m_Data.insert(m_Data.end(), p, p + size);
+		}
+		catch (const ::std::bad_alloc &)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	virtual const uint8_t *GetData() const
+	{
+		return m_Data.data();
+	}
+
+	virtual size_t GetSize() const
+	{
+		return m_Data.size();
+	}
+
+	virtual void Reset()
+	{
+		m_Data.clear();
+	}
+};
+
+
+// appends everything written, which must be whole TCHARs, to a string
+class CStringDataSink : public props::IDataSink
+{
+protected:
+	tstring &m_Str;
+
+public:
+	CStringDataSink(tstring &str) : m_Str(str) { }
+
+	virtual bool Write(const void *data, size_t size)
+	{
+		m_Str.append((const TCHAR *)data, size / sizeof(TCHAR));
+
+		return true;
+	}
+};
+
+
+class CFileSink final : public props::IFileSink
+{
+protected:
+	FILE *m_pFile;
+
+public:
+	CFileSink(FILE *pf)
+	{
+		m_pFile = pf;
+		setvbuf(m_pFile, nullptr, _IOFBF, 1 << 16);
+	}
+
+	virtual ~CFileSink()
+	{
+		Close();
+	}
+
+	virtual void Release()
+	{
+		delete this;
+	}
+
+	virtual bool Write(const void *data, size_t size)
+	{
+		return m_pFile && (fwrite(data, 1, size, m_pFile) == size);
+	}
+
+	virtual bool Close()
+	{
+		if (!m_pFile)
+			return false;
+
+		bool ret = (fflush(m_pFile) == 0);
+		ret &= (fclose(m_pFile) == 0);
+		m_pFile = nullptr;
+
+		return ret;
+	}
+};
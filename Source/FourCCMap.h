@@ -0,0 +1,324 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// FourCCMap.h : a flat, open-addressed hash table keyed by FOURCHARCODE
+//
+// Slots are arranged in groups of 16, each with a parallel array of control bytes
+// (empty, deleted, or the low 7 bits of the key's hash). A probe loads a whole group
+// of control bytes and compares them all at once, so most lookups touch one cache line
+// of control bytes and one slot.
+
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FOURCCMAP_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <type_traits>
+
+
+template <typename T> class CFourCCMap
+{
+	static_assert(std::is_trivially_copyable<T>::value, "CFourCCMap values must be trivially copyable");
+
+protected:
+	enum
+	{
+		GROUP_SIZE = 16,
+
+		CTRL_EMPTY = -128,
+		CTRL_DELETED = -2
+	};
+
+	struct SSlot
+	{
+		props::FOURCHARCODE key;
+		T value;
+	};
+
+	int8_t *m_Ctrl;
+	SSlot *m_Slots;
+	size_t m_Capacity;		// always a multiple of GROUP_SIZE, with a power-of-two number of groups
+	size_t m_Size;
+	size_t m_Deleted;
+
+	static inline uint64_t Hash(props::FOURCHARCODE key)
+	{
+		// FOURCHARCODEs are mostly printable ASCII, so mix them well before splitting the bits up
+		uint64_t h = (uint64_t)key * 0x9E3779B97F4A7C15ULL;
+		return h ^ (h >> 29);
+	}
+
+	static inline int8_t H2(uint64_t h) { return (int8_t)(h & 0x7F); }
+
+	static inline size_t H1(uint64_t h) { return (size_t)(h >> 7); }
+
+	// returns a bitmask of the positions in the group whose control byte equals c
+	static inline uint32_t MatchGroup(const int8_t *grp, int8_t c)
+	{
+#if defined(FOURCCMAP_SSE2)
+		__m128i g = _mm_loadu_si128((const __m128i *)grp);
+		return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+		uint32_t m = 0;
+		for (uint32_t i = 0; i < GROUP_SIZE; i++)
+		{
+			if (grp[i] == c)
+				m |= (1 << i);
+		}
+		return m;
+#endif
+	}
+
+	// returns a bitmask of the positions in the group that are empty or deleted (the only negative control values)
+	static inline uint32_t MatchFree(const int8_t *grp)
+	{
+#if defined(FOURCCMAP_SSE2)
+		__m128i g = _mm_loadu_si128((const __m128i *)grp);
+		return (uint32_t)_mm_movemask_epi8(g);
+#else
+		uint32_t m = 0;
+		for (uint32_t i = 0; i < GROUP_SIZE; i++)
+		{
+			if (grp[i] < 0)
+				m |= (1 << i);
+		}
+		return m;
+#endif
+	}
+
+	static inline uint32_t LowestBit(uint32_t m)
+	{
+#if defined(_MSC_VER)
+		unsigned long i;
+		_BitScanForward(&i, m);
+		return (uint32_t)i;
+#else
+		return (uint32_t)__builtin_ctz(m);
+#endif
+	}
+
+	// returns the slot index holding key, or m_Capacity if it isn't present
+	size_t FindSlot(props::FOURCHARCODE key) const
+	{
+		if (!m_Size)
+			return m_Capacity;
+
+		uint64_t h = Hash(key);
+		int8_t h2 = H2(h);
+		size_t gmask = (m_Capacity / GROUP_SIZE) - 1;
+		size_t g = H1(h) & gmask;
+
+		for (size_t probe = 1; probe <= gmask + 1; probe++)
+		{
+			const int8_t *grp = m_Ctrl + (g * GROUP_SIZE);
+
+			uint32_t m = MatchGroup(grp, h2);
+			while (m)
+			{
+				size_t i = (g * GROUP_SIZE) + LowestBit(m);
+				if (m_Slots[i].key == key)
+					return i;
+
+				m &= (m - 1);
+			}
+
+			// an empty slot terminates the probe sequence
+			if (MatchGroup(grp, CTRL_EMPTY))
+				break;
+
+			// triangular probing visits every group when the group count is a power of two
+			g = (g + probe) & gmask;
+		}
+
+		return m_Capacity;
+	}
+
+	// places a key that is known not to be present; the table must have room
+	size_t PlaceSlot(props::FOURCHARCODE key, T value)
+	{
+		uint64_t h = Hash(key);
+		size_t gmask = (m_Capacity / GROUP_SIZE) - 1;
+		size_t g = H1(h) & gmask;
+
+		for (size_t probe = 1; ; probe++)
+		{
+			uint32_t m = MatchFree(m_Ctrl + (g * GROUP_SIZE));
+			if (m)
+			{
+				size_t i = (g * GROUP_SIZE) + LowestBit(m);
+				if (m_Ctrl[i] == CTRL_DELETED)
+					m_Deleted--;
+
+				m_Ctrl[i] = H2(h);
+				m_Slots[i].key = key;
+				m_Slots[i].value = value;
+				m_Size++;
+				return i;
+			}
+
+			g = (g + probe) & gmask;
+		}
+	}
+
+	void Rehash(size_t newcap)
+	{
+		int8_t *oldctrl = m_Ctrl;
+		SSlot *oldslots = m_Slots;
+		size_t oldcap = m_Capacity;
+
+		m_Capacity = newcap;
+		m_Ctrl = (int8_t *)malloc(m_Capacity * sizeof(int8_t));
+		m_Slots = (SSlot *)malloc(m_Capacity * sizeof(SSlot));
+		memset(m_Ctrl, CTRL_EMPTY, m_Capacity * sizeof(int8_t));
+		m_Size = 0;
+		m_Deleted = 0;
+
+		for (size_t i = 0; i < oldcap; i++)
+		{
+			if (oldctrl[i] >= 0)
+				PlaceSlot(oldslots[i].key, oldslots[i].value);
+		}
+
+		free(oldctrl);
+		free(oldslots);
+	}
+
+	// the smallest legal capacity that holds count entries under a 7/8 load factor
+	static size_t CapacityFor(size_t count)
+	{
+		size_t cap = GROUP_SIZE;
+		while (((cap * 7) / 8) < count)
+			cap <<= 1;
+		return cap;
+	}
+
+public:
+	CFourCCMap()
+	{
+		m_Ctrl = nullptr;
+		m_Slots = nullptr;
+		m_Capacity = 0;
+		m_Size = 0;
+		m_Deleted = 0;
+	}
+
+	~CFourCCMap()
+	{
+		free(m_Ctrl);
+		free(m_Slots);
+	}
+
+	CFourCCMap(const CFourCCMap &) = delete;
+	CFourCCMap &operator =(const CFourCCMap &) = delete;
+
+	inline size_t Size() const { return m_Size; }
+
+	inline bool Empty() const { return (m_Size == 0); }
+
+	/// Makes room for at least count entries without further rehashing
+	void Reserve(size_t count)
+	{
+		size_t cap = CapacityFor(count);
+		if (cap > m_Capacity)
+			Rehash(cap);
+	}
+
+	/// Returns a pointer to the value stored for key, or nullptr if there isn't one
+	T *Find(props::FOURCHARCODE key)
+	{
+		size_t i = FindSlot(key);
+		return (i < m_Capacity) ? &m_Slots[i].value : nullptr;
+	}
+
+	const T *Find(props::FOURCHARCODE key) const
+	{
+		size_t i = FindSlot(key);
+		return (i < m_Capacity) ? &m_Slots[i].value : nullptr;
+	}
+
+	/// Inserts the value if key is not already present. Like std::map::insert, an existing
+	/// value is not replaced. Returns true if the value was inserted.
+	bool Insert(props::FOURCHARCODE key, T value)
+	{
+		if (FindSlot(key) < m_Capacity)
+			return false;
+
+		// tombstones take up probe length, so count them against the load factor too
+		if (!m_Capacity)
+			Rehash(GROUP_SIZE);
+		else if (((m_Size + m_Deleted + 1) * 8) > (m_Capacity * 7))
+			Rehash(CapacityFor(m_Size + 1) > m_Capacity ? (m_Capacity << 1) : m_Capacity);
+
+		PlaceSlot(key, value);
+		return true;
+	}
+
+	/// Removes key from the table. Returns true if it was present.
+	bool Erase(props::FOURCHARCODE key)
+	{
+		size_t i = FindSlot(key);
+		if (i >= m_Capacity)
+			return false;
+
+		// if the group still has an empty slot, no probe sequence can have passed through it
+		// looking for this key, so the slot can go straight back to empty
+		const int8_t *grp = m_Ctrl + ((i / GROUP_SIZE) * GROUP_SIZE);
+		if (MatchGroup(grp, CTRL_EMPTY))
+		{
+			m_Ctrl[i] = CTRL_EMPTY;
+		}
+		else
+		{
+			m_Ctrl[i] = CTRL_DELETED;
+			m_Deleted++;
+		}
+
+		m_Size--;
+		return true;
+	}
+
+	/// Removes all entries, keeping the current capacity
+	void Clear()
+	{
+		if (m_Ctrl)
+			memset(m_Ctrl, CTRL_EMPTY, m_Capacity * sizeof(int8_t));
+
+		m_Size = 0;
+		m_Deleted = 0;
+	}
+};
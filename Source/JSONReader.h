@@ -0,0 +1,394 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// JSONReader.h : a single-pass reader for property sets written by SerializeToJSON
+//
+// Like CXMLReader, this walks the source once and returns each property's members as spans into
+// it, to be interpreted once the whole object has been read (so member order doesn't matter).
+// Members it doesn't know are skipped, so documents that other tools have added to still load.
+
+#pragma once
+
+
+class CJSONReader
+{
+protected:
+	const TCHAR *m_Pos, *m_End;
+
+	enum STATE
+	{
+		S_START = 0,
+		S_INSET,
+		S_DONE
+	};
+
+	STATE m_State;
+	bool m_First;
+
+	void SkipSpace()
+	{
+		while ((m_Pos < m_End) && _istspace(*m_Pos))
+			m_Pos++;
+	}
+
+	// moves past c, and any whitespace before it, if it's next
+	bool Accept(TCHAR c)
+	{
+		SkipSpace();
+		if ((m_Pos == m_End) || (*m_Pos != c))
+			return false;
+
+		m_Pos++;
+		return true;
+	}
+
+	// reads a string and returns what's between the quotes, still escaped
+	bool ReadString(STextSpan &s)
+	{
+		if (!Accept(_T('\"')))
+			return false;
+
+		s.p = m_Pos;
+		while ((m_Pos < m_End) && (*m_Pos != _T('\"')))
+		{
+			if (*m_Pos == _T('\\'))
+				m_Pos++;
+
+			m_Pos++;
+		}
+
+		if (m_Pos >= m_End)
+			return false;
+
+		s.len = m_Pos - s.p;
+		m_Pos++;
+
+		return true;
+	}
+
+	// moves past any value and returns its text; strings keep their quotes
+	bool ReadValue(STextSpan &v)
+	{
+		SkipSpace();
+		v.p = m_Pos;
+
+		if (m_Pos == m_End)
+			return false;
+
+		STextSpan s;
+		if (*m_Pos == _T('\"'))
+		{
+			if (!ReadString(s))
+				return false;
+		}
+		else if ((*m_Pos == _T('[')) || (*m_Pos == _T('{')))
+		{
+			size_t depth = 0;
+			do
+			{
+				if (*m_Pos == _T('\"'))
+				{
+					if (!ReadString(s))
+						return false;
+
+					continue;
+				}
+
+				if ((*m_Pos == _T('[')) || (*m_Pos == _T('{')))
+					depth++;
+				else if ((*m_Pos == _T(']')) || (*m_Pos == _T('}')))
+					depth--;
+
+				m_Pos++;
+			}
+			while (depth && (m_Pos < m_End));
+
+			if (depth)
+				return false;
+		}
+		else
+		{
+			// a number, true, false or null
+			while ((m_Pos < m_End) && !_istspace(*m_Pos) && (*m_Pos != _T(',')) && (*m_Pos != _T('}')) && (*m_Pos != _T(']')))
+				m_Pos++;
+		}
+
+		v.len = m_Pos - v.p;
+
+		return (v.len > 0);
+	}
+
+	// reads the members that follow the property array, up to the end of the document's object
+	bool Finish()
+	{
+		STextSpan key, val;
+		while (Accept(_T(',')))
+		{
+			if (!ReadString(key) || !Accept(_T(':')) || !ReadValue(val))
+				return false;
+		}
+
+		m_State = S_DONE;
+
+		return Accept(_T('}'));
+	}
+
+public:
+	// the members of one property object; anything not present is empty
+	struct SProperty
+	{
+		STextSpan id, name, type, aspect, flags;
+		STextSpan value, enumstrs;
+	};
+
+	enum RESULT
+	{
+		R_PROPERTY = 0,
+		R_END,
+		R_ERROR
+	};
+
+	CJSONReader(const TCHAR *src, size_t len)
+	{
+		m_Pos = src;
+		m_End = src + len;
+		m_State = S_START;
+		m_First = true;
+	}
+
+	RESULT Next(SProperty &prop)
+	{
+		STextSpan key, val;
+
+		if (m_State == S_DONE)
+			return R_END;
+
+		if (m_State == S_START)
+		{
+			SkipSpace();
+			if (m_Pos == m_End)
+			{
+				m_State = S_DONE;
+				return R_END;
+			}
+
+			if (!Accept(_T('{')))
+				return R_ERROR;
+
+			if (Accept(_T('}')))
+			{
+				m_State = S_DONE;
+				return R_END;
+			}
+
+			// find the property array among the document's members
+			do
+			{
+				if (!ReadString(key) || !Accept(_T(':')))
+					return R_ERROR;
+
+				if (key.Is(_T("property_set")))
+				{
+					if (!Accept(_T('[')))
+						return R_ERROR;
+
+					m_State = S_INSET;
+					break;
+				}
+
+				if (!ReadValue(val))
+					return R_ERROR;
+			}
+			while (Accept(_T(',')));
+
+			if (m_State == S_START)
+			{
+				m_State = S_DONE;
+				return Accept(_T('}')) ? R_END : R_ERROR;
+			}
+		}
+
+		if (Accept(_T(']')))
+			return Finish() ? R_END : R_ERROR;
+
+		if (!m_First && !Accept(_T(',')))
+			return R_ERROR;
+
+		m_First = false;
+
+		if (!Accept(_T('{')))
+			return R_ERROR;
+
+		prop.id.Clear();
+		prop.name.Clear();
+		prop.type.Clear();
+		prop.aspect.Clear();
+		prop.flags.Clear();
+		prop.value.Clear();
+		prop.enumstrs.Clear();
+
+		if (Accept(_T('}')))
+			return R_PROPERTY;
+
+		do
+		{
+			if (!ReadString(key) || !Accept(_T(':')) || !ReadValue(val))
+				return R_ERROR;
+
+			if (key.Is(_T("id")))
+				prop.id = val;
+			else if (key.Is(_T("name")))
+				prop.name = val;
+			else if (key.Is(_T("type")))
+				prop.type = val;
+			else if (key.Is(_T("aspect")))
+				prop.aspect = val;
+			else if (key.Is(_T("flags")))
+				prop.flags = val;
+			else if (key.Is(_T("value")))
+				prop.value = val;
+			else if (key.Is(_T("enum")))
+				prop.enumstrs = val;
+		}
+		while (Accept(_T(',')));
+
+		return Accept(_T('}')) ? R_PROPERTY : R_ERROR;
+	}
+
+	// the text between a string's quotes, or the span itself if it isn't a string
+	static STextSpan Unquote(const STextSpan &s)
+	{
+		if ((s.len >= 2) && (s.p[0] == _T('\"')) && (s.p[s.len - 1] == _T('\"')))
+		{
+			STextSpan ret = {s.p + 1, s.len - 2};
+			return ret;
+		}
+
+		return s;
+	}
+
+	// appends the contents of a string (as returned by Unquote) to out, replacing its escape sequences
+	static void AppendUnescaped(const STextSpan &s, tstring &out)
+	{
+		const TCHAR *c = s.p, *end = s.p + s.len;
+		while (c < end)
+		{
+			const TCHAR *bs = c;
+			while ((bs < end) && (*bs != _T('\\')))
+				bs++;
+
+			out.append(c, bs - c);
+			c = bs;
+			if ((c == end) || (++c == end))
+				break;
+
+			switch (*(c++))
+			{
+				case _T('b'): out += _T('\b'); break;
+				case _T('f'): out += _T('\f'); break;
+				case _T('n'): out += _T('\n'); break;
+				case _T('r'): out += _T('\r'); break;
+				case _T('t'): out += _T('\t'); break;
+
+				case _T('u'):
+				{
+					uint32_t v = 0;
+					size_t i = 0;
+					for (; (i < 4) && (c < end) && _istxdigit(*c); i++, c++)
+						v = (v << 4) | (uint32_t)(_istdigit(*c) ? (*c - _T('0')) : ((*c | 0x20) - _T('a') + 10));
+
+					out += (TCHAR)v;
+					break;
+				}
+
+				// \" \\ \/ and anything else stand for the character itself
+				default: out += *(c - 1); break;
+			}
+		}
+	}
+
+	static void Unescape(const STextSpan &s, tstring &out)
+	{
+		out.clear();
+		AppendUnescaped(Unquote(s), out);
+	}
+
+	// an enum's strings are an array; this joins them with commas, the way SetEnumStrings wants them
+	static bool JoinStrings(const STextSpan &s, tstring &out)
+	{
+		out.clear();
+
+		CJSONReader r(s.p, s.len);
+		if (!r.Accept(_T('[')))
+			return false;
+
+		if (r.Accept(_T(']')))
+			return true;
+
+		STextSpan str;
+		bool first = true;
+		do
+		{
+			if (!r.ReadString(str))
+				return false;
+
+			if (!first)
+				out += _T(',');
+
+			first = false;
+
+			AppendUnescaped(str, out);
+		}
+		while (r.Accept(_T(',')));
+
+		return r.Accept(_T(']'));
+	}
+
+	// ids are strings of up to four characters, most significant first
+	static bool DecodeID(const STextSpan &s, tstring &scratch, props::FOURCHARCODE &fcc)
+	{
+		Unescape(s, scratch);
+		if (scratch.length() > 4)
+			return false;
+
+		fcc = 0;
+		for (TCHAR c : scratch)
+		{
+			if ((unsigned)c > 0xFF)
+				return false;
+
+			fcc = (fcc << 8) | (uint8_t)c;
+		}
+
+		return true;
+	}
+};
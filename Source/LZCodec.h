@@ -0,0 +1,221 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// LZCodec.h : the built-in IPropertyCodec, a byte-oriented LZ77 in the style of LZ4
+//
+// The compressed data is a series of sequences. Each begins with a token byte whose high nibble is
+// the number of literals and whose low nibble is the match length less 4; a nibble of 15 means more
+// length bytes follow, each added on, until one isn't 255. Then come the literals, a 16-bit
+// little-endian offset back into the output, and any extra match length bytes. The last sequence
+// stops after its literals.
+
+#pragma once
+
+
+class CLZCodec : public props::IPropertyCodec
+{
+protected:
+	enum
+	{
+		MIN_MATCH = 4,
+		MAX_OFFSET = 0xFFFF,
+		HASH_BITS = 12
+	};
+
+	static uint32_t Read32(const uint8_t *p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(uint32_t));
+		return v;
+	}
+
+	static uint32_t Hash(uint32_t v)
+	{
+		return (v * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	static void PutLength(::std::vector<uint8_t> &out, size_t len)
+	{
+		for (; len >= 255; len -= 255)
+			out.push_back(255);
+
+		out.push_back(uint8_t(len));
+	}
+
+	static void PutSequence(::std::vector<uint8_t> &out, const uint8_t *lit, size_t litlen, size_t offset, size_t matchlen)
+	{
+		size_t ml = matchlen ? (matchlen - MIN_MATCH) : 0;
+
+		out.push_back(uint8_t((::std::min<size_t>(litlen, 15) << 4) | ::std::min<size_t>(ml, 15)));
+		if (litlen >= 15)
+			PutLength(out, litlen - 15);
+
+		out.insert(out.end(), lit, lit + litlen);
+
+		if (!matchlen)
+			return;
+
+		out.push_back(uint8_t(offset));
+		out.push_back(uint8_t(offset >> 8));
+
+		if (ml >= 15)
+			PutLength(out, ml - 15);
+	}
+
+	// reads the extra bytes of a length whose nibble was 15; false if the input runs out first
+	static bool GetLength(const uint8_t *&ip, const uint8_t *iend, size_t &len)
+	{
+		uint8_t b;
+		do
+		{
+			if (ip >= iend)
+				return false;
+
+			b = *(ip++);
+			len += b;
+		}
+		while (b == 255);
+
+		return true;
+	}
+
+public:
+	virtual uint32_t GetID() const
+	{
+		return 'PPLZ';
+	}
+
+	// every extra length byte adds at most 255 to a match, and nothing else expands more than that
+	virtual size_t GetMaxRatio() const
+	{
+		return 255;
+	}
+
+	virtual bool Compress(const void *data, size_t size, props::IDataSink *psink)
+	{
+		if (!psink || (!data && size))
+			return false;
+
+		const uint8_t *src = (const uint8_t *)data, *ip = src, *anchor = src, *end = src + size;
+
+		::std::vector<uint8_t> out;
+		out.reserve(size + (size / 255) + 16);
+
+		// the most recent position, plus one, of each hashed 4-byte sequence
+		::std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+
+		while ((size_t)(end - ip) >= MIN_MATCH)
+		{
+			uint32_t v = Read32(ip);
+			uint32_t h = Hash(v);
+			uint32_t cand = table[h];
+			table[h] = uint32_t(ip - src) + 1;
+
+			const uint8_t *match = src + cand - 1;
+			if (!cand || ((size_t)(ip - match) > MAX_OFFSET) || (Read32(match) != v))
+			{
+				ip++;
+				continue;
+			}
+
+			size_t len = MIN_MATCH;
+			while (((ip + len) < end) && (match[len] == ip[len]))
+				len++;
+
+			PutSequence(out, anchor, ip - anchor, ip - match, len);
+
+			ip += len;
+			anchor = ip;
+		}
+
+		PutSequence(out, anchor, end - anchor, 0, 0);
+
+		return psink->Write(out.data(), out.size());
+	}
+
+	virtual bool Decompress(const void *data, size_t size, void *dst, size_t dstsize)
+	{
+		if ((!data && size) || (!dst && dstsize))
+			return false;
+
+		const uint8_t *ip = (const uint8_t *)data, *iend = ip + size;
+		uint8_t *op = (uint8_t *)dst, *oend = op + dstsize;
+
+		while (ip < iend)
+		{
+			uint8_t token = *(ip++);
+
+			size_t litlen = token >> 4;
+			if ((litlen == 15) && !GetLength(ip, iend, litlen))
+				return false;
+
+			if (((size_t)(iend - ip) < litlen) || ((size_t)(oend - op) < litlen))
+				return false;
+
+			memcpy(op, ip, litlen);
+			ip += litlen;
+			op += litlen;
+
+			// the last sequence has no match
+			if (ip == iend)
+				break;
+
+			if ((iend - ip) < 2)
+				return false;
+
+			size_t offset = ip[0] | (size_t(ip[1]) << 8);
+			ip += 2;
+
+			size_t matchlen = token & 0x0F;
+			if ((matchlen == 15) && !GetLength(ip, iend, matchlen))
+				return false;
+			matchlen += MIN_MATCH;
+
+			if (!offset || (offset > (size_t)(op - (uint8_t *)dst)) || ((size_t)(oend - op) < matchlen))
+				return false;
+
+			// matches may overlap what they're producing, so they're copied forward a byte at a time
+			const uint8_t *match = op - offset;
+			for (size_t i = 0; i < matchlen; i++)
+				op[i] = match[i];
+			op += matchlen;
+		}
+
+		return (op == oend);
+	}
+
+	static CLZCodec *Get()
+	{
+		static CLZCodec codec;
+		return &codec;
+	}
+};
@@ -0,0 +1,265 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// NamePool.h : a process-wide pool of interned property names
+//
+// Every property holds a pointer into the pool instead of its own copy of its name, so
+// thousands of sets sharing the same layout share one copy of each name. Each pooled
+// name also points at the pooled lower-case spelling of itself, which gives every name
+// that compares equal case-insensitively the same key; sets index names by that spelling,
+// so looking a name up folds it on the caller's stack and never touches the pool's lock.
+// Interning a name that's already pooled, or dropping a reference that isn't the last,
+// shares the lock with other threads doing the same; only adding and removing entries
+// takes it exclusively.
+
+#pragma once
+
+
+class CNamePool
+{
+public:
+	typedef ::std::basic_string_view<TCHAR> TNameView;
+
+protected:
+	struct SEntry
+	{
+		const SEntry *m_pFolded;		// the lower-case spelling; this entry itself if the name is already lower-case
+		::std::atomic<size_t> m_Refs;
+		size_t m_Len;
+		TCHAR m_Str[1];					// allocated to fit the name
+	};
+
+	typedef ::std::unordered_map<TNameView, SEntry *> TEntryMap;
+	TEntryMap m_Entries;				// keys view the entries' own strings
+
+	// sets may live on different threads, but they all share the pool
+	::std::shared_mutex m_Lock;
+
+	size_t m_EntryBytes;
+	::std::atomic<size_t> m_NameRefs;
+	::std::atomic<size_t> m_UnpooledBytes;
+
+	CNamePool() : m_EntryBytes(0), m_NameRefs(0), m_UnpooledBytes(0) { }
+
+	static SEntry *EntryOf(const TCHAR *s)
+	{
+		return (SEntry *)((uint8_t *)s - offsetof(SEntry, m_Str));
+	}
+
+	static size_t EntrySize(size_t len)
+	{
+		return offsetof(SEntry, m_Str) + ((len + 1) * sizeof(TCHAR));
+	}
+
+	// lower-cases s into buf if it fits, otherwise into big
+	static const TCHAR *Fold(const TCHAR *s, size_t len, TCHAR *buf, size_t bufsize, tstring &big)
+	{
+		TCHAR *f = buf;
+		if (len >= bufsize)
+		{
+			big.resize(len);
+			f = &big[0];
+		}
+
+		for (size_t i = 0; i < len; i++)
+			f[i] = (TCHAR)_totlower(s[i]);
+
+		return f;
+	}
+
+	// m_Lock must be held exclusively
+	SEntry *Acquire(const TCHAR *s, size_t len)
+	{
+		TEntryMap::iterator it = m_Entries.find(TNameView(s, len));
+		if (it != m_Entries.end())
+		{
+			it->second->m_Refs++;
+			return it->second;
+		}
+
+		TCHAR buf[64];
+		tstring big;
+		const TCHAR *folded = Fold(s, len, buf, _countof(buf), big);
+
+		const SEntry *pfolded = nullptr;
+		if (memcmp(folded, s, len * sizeof(TCHAR)))
+		{
+			pfolded = Acquire(folded, len);
+			if (!pfolded)
+				return nullptr;
+		}
+
+		SEntry *e = (SEntry *)malloc(EntrySize(len));
+		if (!e)
+		{
+			if (pfolded)
+				Unacquire(const_cast<SEntry *>(pfolded));
+			return nullptr;
+		}
+
+		memcpy(e->m_Str, s, len * sizeof(TCHAR));
+		e->m_Str[len] = _T('\0');
+		e->m_Len = len;
+		e->m_Refs = 1;
+		e->m_pFolded = pfolded ? pfolded : e;
+
+		m_Entries.insert(TEntryMap::value_type(TNameView(e->m_Str, len), e));
+		m_EntryBytes += EntrySize(len);
+
+		return e;
+	}
+
+	// m_Lock must be held exclusively
+	void Unacquire(SEntry *e)
+	{
+		if (--e->m_Refs)
+			return;
+
+		m_Entries.erase(TNameView(e->m_Str, e->m_Len));
+		m_EntryBytes -= EntrySize(e->m_Len);
+
+		if (e->m_pFolded != e)
+			Unacquire(const_cast<SEntry *>(e->m_pFolded));
+
+		free(e);
+	}
+
+public:
+
+	static CNamePool &Get()
+	{
+		// never destroyed, so that sets released during static destruction can still drop their names
+		static CNamePool *pool = new CNamePool();
+		return *pool;
+	}
+
+	// returns the pooled copy of s; each call must be balanced by a call to Release
+	const TCHAR *Intern(const TCHAR *s)
+	{
+		if (!s)
+			s = _T("");
+
+		size_t len = _tcslen(s);
+
+		SEntry *e = nullptr;
+
+		{
+			::std::shared_lock<::std::shared_mutex> lock(m_Lock);
+
+			TEntryMap::iterator it = m_Entries.find(TNameView(s, len));
+			if (it != m_Entries.end())
+			{
+				e = it->second;
+				e->m_Refs++;
+			}
+		}
+
+		if (!e)
+		{
+			::std::unique_lock<::std::shared_mutex> lock(m_Lock);
+
+			e = Acquire(s, len);
+			if (!e)
+				return nullptr;
+		}
+
+		m_NameRefs++;
+		m_UnpooledBytes += (len + 1) * sizeof(TCHAR);
+
+		return e->m_Str;
+	}
+
+	void Release(const TCHAR *s)
+	{
+		if (!s)
+			return;
+
+		SEntry *e = EntryOf(s);
+
+		m_NameRefs--;
+		m_UnpooledBytes -= (e->m_Len + 1) * sizeof(TCHAR);
+
+		// the caller's reference keeps the entry alive, so any but the last can be dropped without the lock
+		size_t refs = e->m_Refs;
+		while (refs > 1)
+		{
+			if (e->m_Refs.compare_exchange_weak(refs, refs - 1))
+				return;
+		}
+
+		::std::unique_lock<::std::shared_mutex> lock(m_Lock);
+
+		Unacquire(e);
+	}
+
+	// the case-insensitive key of a pooled name; it views the pool, so it lives as long as the name does
+	static TNameView Key(const TCHAR *pooled)
+	{
+		if (!pooled)
+			return TNameView();
+
+		const SEntry *f = EntryOf(pooled)->m_pFolded;
+		return TNameView(f->m_Str, f->m_Len);
+	}
+
+	// the key an arbitrary name would have, folded into its own storage so that finding it needs no lock
+	class CLookupKey
+	{
+	protected:
+		TCHAR m_Buf[64];
+		tstring m_Big;
+		TNameView m_Key;
+
+	public:
+		CLookupKey(const TCHAR *s)
+		{
+			size_t len = _tcslen(s);
+			m_Key = TNameView(Fold(s, len, m_Buf, _countof(m_Buf), m_Big), len);
+		}
+
+		operator TNameView() const { return m_Key; }
+	};
+
+	void GetStats(props::IPropertySet::SNamePoolStats *stats)
+	{
+		::std::shared_lock<::std::shared_mutex> lock(m_Lock);
+
+		stats->UniqueNames = m_Entries.size();
+		stats->References = m_NameRefs;
+
+		// entries plus an estimate of the hash table's nodes and buckets
+		stats->PooledBytes = m_EntryBytes + (m_Entries.size() * (sizeof(TEntryMap::value_type) + (sizeof(void *) * 2))) +
+			(m_Entries.bucket_count() * sizeof(void *));
+
+		stats->UnpooledBytes = m_UnpooledBytes;
+	}
+};
@@ -31,7 +31,17 @@ SOFTWARE.
 
 #include "stdafx.h"
 #include <PowerProps.h>
-#include <GenIO.h>
+#include "FourCCMap.h"
+#include "PropertyArena.h"
+#include "NamePool.h"
+#include "DataSink.h"
+#include "CompactEncoding.h"
+#include "AlignedEncoding.h"
+#include "LZCodec.h"
+#include "ValueFormatter.h"
+#include "ValueParser.h"
+#include "XMLReader.h"
+#include "JSONReader.h"
 
 
 using namespace props;
@@ -41,31 +51,106 @@ using namespace props;
 #define PROPFLAG_ENUMPROVIDER	(1 << 30)
 
 
-class CPropertySet : public IPropertySet
+class CProperty;
+
+// the parts of IPropertySet that can be written entirely against the interface, shared by every kind of set
+class CPropertySetBase : public IPropertySet
+{
+public:
+	IPropertyChangeListener *m_pListener;
+
+	CPropertySetBase() : m_pListener(nullptr) { }
+
+	virtual void AppendPropertySet(const IPropertySet *propset, bool overwrite_flags = false);
+	using IPropertySet::Serialize;
+	virtual bool Serialize(IProperty::SERIALIZE_MODE mode, BYTE *buf, size_t bufsize, size_t *amountused) const;
+	virtual bool SerializeToXMLString(IProperty::SERIALIZE_MODE mode, tstring &xmls) const;
+	virtual bool SerializeToXML(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
+	virtual bool DeserializeFromXMLString(const tstring &xmls);
+	virtual bool SerializeToJSON(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
+	virtual bool SerializeToJSONString(IProperty::SERIALIZE_MODE mode, tstring &jsons) const;
+	virtual bool DeserializeFromJSON(const tstring &jsons);
+	virtual bool ApplyDelta(BYTE *buf, size_t bufsize, size_t *bytesconsumed);
+	virtual bool DeserializeChunked(IDataSource *psource);
+	virtual bool SerializeCompressed(IProperty::SERIALIZE_MODE mode, IPropertyCodec *pcodec, IDataSink *psink) const;
+	virtual bool DeserializeCompressed(const uint8_t *buf, size_t bufsize, IPropertyCodec *pcodec, size_t *bytesconsumed);
+	virtual void SetChangeListener(const IPropertyChangeListener *plistener);
+
+	// a delta is a flag byte, a 32-bit count and the ids of deleted properties, then the changed properties in Serialize's format
+	enum { DELTA_CLEAR = 0x01 };		// the set was emptied first
+
+	static bool WriteDeltaHeader(IDataSink *psink, bool clear, const FOURCHARCODE *deleted, size_t numdeleted);
+};
+
+class CPropertySet : public CPropertySetBase
 {
 protected:
-	typedef ::std::deque<IProperty *> TPropertyArray;
+	// deletions swap the last property into the vacated index, so removal never shifts the array
+	typedef ::std::vector<IProperty *> TPropertyArray;
 	TPropertyArray m_Props;
 
-	typedef ::std::map<FOURCHARCODE, IProperty *> TPropertyMap;
-	typedef ::std::pair<FOURCHARCODE, IProperty *> TPropertyMapPair;
+	typedef CFourCCMap<IProperty *> TPropertyMap;
 	TPropertyMap m_mapProps;
 
+	// keyed by the name pool's case-insensitive key for each property's name; lookups fold the name themselves
+	typedef ::std::unordered_multimap<CNamePool::TNameView, IProperty *> TPropertyNameMap;
+	TPropertyNameMap m_mapNames;
+
+	// every property occupies a handle slot; deleting the property bumps the slot's generation so old handles go stale
+	struct SHandleSlot
+	{
+		CProperty *m_pProp;				// nullptr while the slot is free
+		uint32_t m_Generation;			// never 0
+		uint32_t m_NextFree;
+	};
+	typedef ::std::vector<SHandleSlot> THandleSlotArray;
+	THandleSlotArray m_Slots;
+
+	static const uint32_t NO_SLOT = UINT32_MAX;
+	uint32_t m_FreeSlot;
+
+	// unlinks a property from the array, maps and handle slots, then releases it
+	void RemoveProperty(CProperty *pprop);
+
+	// the shared allocations made by CreateProperties, from the arena when there is one; freed by DeleteAll
+	struct SBlock
+	{
+		void *m_pMem;
+		size_t m_Size;					// the arena has to be given back the size it handed out
+	};
+	typedef ::std::vector<SBlock> TBlockArray;
+	TBlockArray m_Blocks;
+
+	// the stamp of each deleted id's latest deletion, kept once GetCheckpoint has been called; an id is dropped when a
+	// property with it is added again, since the delta carries the new property instead
+	typedef ::std::unordered_map<FOURCHARCODE, uint64_t> TDeletionLog;
+	TDeletionLog m_Deletions;
+	mutable bool m_TrackDeletions;
+
+	// the stamp of the last DeleteAll; everything deleted before that is implied by it
+	uint64_t m_ClearStamp;
+
 public:
-	IPropertyChangeListener *m_pListener;
+	// only present when the set was created with AM_ARENA
+	CPropertyArena *m_pArena;
+
+	// bumped by every change; each property remembers the stamp of its last change so deltas can find what changed
+	uint64_t m_Stamp;
 
 public:
 
-	CPropertySet();
+	CPropertySet(ALLOCATION_MODE mode = AM_HEAP);
 	virtual ~CPropertySet();
 
 	virtual void Release();
 	virtual IProperty *CreateProperty(const TCHAR *propname, FOURCHARCODE propid);
 	virtual IProperty *CreateReferenceProperty(const TCHAR *propname, FOURCHARCODE propid, void *addr, IProperty::PROPERTY_TYPE type);
+	virtual size_t CreateProperties(const SPropertyDesc *descs, size_t count);
 	virtual void AddProperty(IProperty *pprop);
 	virtual void DeleteProperty(size_t idx);
 	virtual void DeletePropertyById(FOURCHARCODE propid);
 	virtual void DeletePropertyByName(const TCHAR *propname);
+	virtual void DeletePropertyByHandle(PropertyHandle handle);
 	virtual void DeleteAll();
 	virtual size_t GetPropertyCount() const;
 	virtual IProperty *GetProperty(size_t idx) const;
@@ -73,29 +158,65 @@ public:
 	virtual IProperty *operator [](FOURCHARCODE propid) const { return GetPropertyById(propid); }
 	virtual IProperty *GetPropertyByName(const TCHAR *propname) const;
 	virtual IProperty *operator [](const TCHAR *propname) const { return GetPropertyByName(propname); }
+	virtual PropertyHandle GetPropertyHandle(FOURCHARCODE propid) const;
+	virtual IProperty *GetPropertyByHandle(PropertyHandle handle) const;
 	virtual CPropertySet &operator =(IPropertySet *propset);
 	virtual CPropertySet &operator +=(IPropertySet *propset);
-	virtual void AppendPropertySet(const IPropertySet *propset, bool overwrite_flags = false);
-	virtual bool Serialize(IProperty::SERIALIZE_MODE mode, BYTE *buf, size_t bufsize, size_t *amountused) const;
+	using CPropertySetBase::Serialize;
+	virtual bool Serialize(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
 	virtual bool Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed);
-	virtual bool SerializeToXMLString(IProperty::SERIALIZE_MODE mode, tstring &xmls) const;
-	virtual bool DeserializeFromXMLString(const tstring &xmls);
-	virtual void SetChangeListener(const IPropertyChangeListener *plistener);
+	virtual bool SerializeChunked(IProperty::SERIALIZE_MODE mode, IDataSink *psink, size_t chunksize) const;
+	virtual bool SerializeArchive(IDataSink *psink) const;
+	virtual uint64_t GetCheckpoint() const;
+	virtual bool SerializeDelta(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
+	virtual void TrimDeltaHistory(uint64_t checkpoint);
+
+	// writes the properties changed since checkpoint in Serialize's format
+	bool SerializeProperties(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
+
+	// reads a SM_BIN_COMPACT set; Deserialize hands these off
+	bool DeserializeCompact(BYTE *buf, size_t bufsize, size_t *bytesconsumed);
+
+	// reads a SM_BIN_ALIGNED set, as DeserializeCompact does
+	bool DeserializeAligned(BYTE *buf, size_t bufsize, size_t *bytesconsumed);
+
+	// keeps the name index in sync; a property must be unindexed before its name changes
+	void IndexName(IProperty *pprop);
+	void UnindexName(IProperty *pprop);
+
+	// allocates a property from the arena if there is one, otherwise from the heap
+	CProperty *NewProperty();
 };
 
 
 
+static bool SetValueFromText(props::IProperty *pp, props::IProperty::PROPERTY_TYPE type, const STextSpan &text, bool *wellformed = nullptr);
+
 class CProperty : public IProperty
 {
 public:
-	tstring m_sName;
+	const TCHAR *m_sName;				// pooled; see CNamePool
 	FOURCHARCODE m_ID;
 	PROPERTY_TYPE m_Type;
 	PROPERTY_ASPECT m_Aspect;
 	TFlags32 m_Flags;
 	CPropertySet *m_pOwner;
 
-	typedef std::deque<tstring> TStringDeque;
+	// maintained by the owner: this property's handle slot and its index in the owner's property array
+	uint32_t m_Handle;
+	uint32_t m_Pos;
+
+	// the owner's stamp when this property last changed
+	uint64_t m_Stamp;
+
+	// strings shorter than this (including the terminator) are stored in the value union rather than allocated
+	enum { SSO_LENGTH = sizeof(TMat4x4F) / sizeof(TCHAR) };
+
+	// true when a PT_STRING value lives in m_ss instead of m_s
+	bool m_InlineStr;
+
+	// true when this property was placed in one of its owner's CreateProperties blocks
+	bool m_Batched;
 
 	union
 	{
@@ -110,10 +231,11 @@ public:
 			};
 			union
 			{
-				TStringDeque *m_es;
+				size_t m_ec;
 				const IEnumProvider *m_pep;
 			};
 		};
+		TCHAR m_ss[SSO_LENGTH];
 		TVec2I m_v2i, *p_v2i;
 		TVec3I m_v3i, *p_v3i;
 		TVec4I m_v4i, *p_v4i;
@@ -132,105 +254,300 @@ public:
 		m_Type = PT_NONE;
 		m_Aspect = PA_GENERIC;
 		m_s = nullptr;
-		m_es = nullptr;
+		m_ec = 0;
+		m_InlineStr = false;
+		m_Batched = false;
+		m_Stamp = 0;
 		m_pOwner = powner;
+		m_sName = nullptr;
 	}
 
 	// call release()!
 	virtual ~CProperty()
 	{
 		Reset();
+		CNamePool::Get().Release(m_sName);
 	}
 
-	size_t RequiredStringLength()
+	// string storage comes from the owning set's arena when it has one, otherwise from the heap
+	TCHAR *AllocChars(size_t count) const
 	{
-		int32_t bufsz = 0;
+		size_t sz = count * sizeof(TCHAR);
+		CPropertyArena *arena = m_pOwner ? m_pOwner->m_pArena : nullptr;
 
-		switch (m_Type)
-		{
-			case PT_ENUM:
-				// the length of each string plus one character... commas for internal delimiters, colon for last, followed by number
-#if defined(_M_X64)
-				bufsz = _sctprintf(_T("%I64d"), m_e);
-#else
-				bufsz = _sctprintf(_T("%lld"), m_e);
-#endif
-				for (TStringDeque::const_iterator it = m_es->cbegin(); it != m_es->cend(); it++)
-					bufsz += _sctprintf(_T("%s"), it->c_str()) + 1;
-				break;
+		return (TCHAR *)(arena ? arena->Alloc(sz) : malloc(sz));
+	}
 
-			case PT_STRING:
-				bufsz = _sctprintf(_T("%s"), m_s);
-				break;
+	// the arena needs the allocation size back, so callers must pass the count they allocated
+	void FreeChars(TCHAR *s, size_t count) const
+	{
+		if (!s)
+			return;
 
-			case PT_BOOLEAN:
-				bufsz = _sctprintf(_T("%d"), m_b);
-				break;
+		CPropertyArena *arena = m_pOwner ? m_pOwner->m_pArena : nullptr;
+		if (arena)
+			arena->Free(s, count * sizeof(TCHAR));
+		else
+			free(s);
+	}
+
+	TCHAR *DupString(const TCHAR *s) const
+	{
+		if (!s)
+			return nullptr;
+
+		size_t len = _tcslen(s) + 1;
+		TCHAR *ret = AllocChars(len);
+		if (ret)
+			memcpy(ret, s, len * sizeof(TCHAR));
+
+		return ret;
+	}
 
+	// strings must not be shortened in place, since their length gives the allocation size
+	void FreeString(TCHAR *s) const
+	{
+		if (s)
+			FreeChars(s, _tcslen(s) + 1);
+	}
+
+	// the current PT_STRING value, wherever it is stored
+	const TCHAR *Str() const
+	{
+		return m_InlineStr ? m_ss : m_s;
+	}
+
+	// the PT_STRING value as text for CValueParser
+	STextSpan StrSpan() const
+	{
+		const TCHAR *s = Str();
+		return {s ? s : _T(""), s ? _tcslen(s) : 0};
+	}
+
+	// where a fixed-size value is kept: in the property, or wherever a reference property was pointed
+	void *ValueAddress() const
+	{
+		bool ref = m_Flags.IsSet(PROPFLAG_REFERENCE);
+
+		switch (m_Type)
+		{
 			case PT_INT:
-				bufsz = _sctprintf(_T("%I64d"), m_i);
-				break;
+				return ref ? (void *)p_i : (void *)&m_i;
 
 			case PT_INT_V2:
-				bufsz = _sctprintf(_T("%I64d,%I64d"), m_v2i.x, m_v2i.y);
-				break;
+				return ref ? (void *)p_v2i : (void *)&m_v2i;
 
 			case PT_INT_V3:
-				bufsz = _sctprintf(_T("%I64d,%I64d,%I64d"), m_v3i.x, m_v3i.y, m_v3i.z);
-				break;
+				return ref ? (void *)p_v3i : (void *)&m_v3i;
 
 			case PT_INT_V4:
-				bufsz = _sctprintf(_T("%I64d,%I64d,%I64d,%I64d"), m_v4i.x, m_v4i.y, m_v4i.z, m_v4i.w);
-				break;
+				return ref ? (void *)p_v4i : (void *)&m_v4i;
 
 			case PT_FLOAT:
-				bufsz = _sctprintf(_T("%f"), m_f);
-				break;
+				return ref ? (void *)p_f : (void *)&m_f;
 
 			case PT_FLOAT_V2:
-				bufsz = _sctprintf(_T("%f,%f"), m_v2f.x, m_v2f.y);
-				break;
+				return ref ? (void *)p_v2f : (void *)&m_v2f;
 
 			case PT_FLOAT_V3:
-				bufsz = _sctprintf(_T("%f,%f,%f"), m_v3f.x, m_v3f.y, m_v3f.z);
-				break;
+				return ref ? (void *)p_v3f : (void *)&m_v3f;
 
 			case PT_FLOAT_V4:
-				bufsz = _sctprintf(_T("%f,%f,%f,%f"), m_v4f.x, m_v4f.y, m_v4f.z, m_v4f.w);
-				break;
+				return ref ? (void *)p_v4f : (void *)&m_v4f;
+
+			case PT_GUID:
+				return ref ? (void *)p_g : (void *)&m_g;
+
+			case PT_BOOLEAN:
+				return ref ? (void *)p_b : (void *)&m_b;
 
 			case PT_FLOAT_MAT3X3:
-				bufsz = _sctprintf(_T("%f,%f,%f,%f,%f,%f,%f,%f,%f"),
-					m_m3x3f.m[0].x, m_m3x3f.m[0].y, m_m3x3f.m[0].z,
-					m_m3x3f.m[1].x, m_m3x3f.m[1].y, m_m3x3f.m[1].z,
-					m_m3x3f.m[2].x, m_m3x3f.m[2].y, m_m3x3f.m[2].z);
-				break;
+				return ref ? (void *)p_m3x3f : (void *)&m_m3x3f;
 
 			case PT_FLOAT_MAT4X4:
-				bufsz = _sctprintf(_T("%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f"),
-					m_m4x4f.m[0].x, m_m4x4f.m[0].y, m_m4x4f.m[0].z, m_m4x4f.m[0].w,
-					m_m4x4f.m[1].x, m_m4x4f.m[1].y, m_m4x4f.m[1].z, m_m4x4f.m[1].w,
-					m_m4x4f.m[2].x, m_m4x4f.m[2].y, m_m4x4f.m[2].z, m_m4x4f.m[2].w,
-					m_m4x4f.m[3].x, m_m4x4f.m[3].y, m_m4x4f.m[3].z, m_m4x4f.m[3].w);
+				return ref ? (void *)p_m4x4f : (void *)&m_m4x4f;
+
+			case PT_ENUM:
+				return (void *)&m_e;
+		}
+
+		return nullptr;
+	}
+
+	// stores a PT_STRING value inline when it fits, otherwise allocates it; the previous value must already be released
+	void StoreString(const TCHAR *s)
+	{
+		size_t len = _tcslen(s) + 1;
+		if (len <= SSO_LENGTH)
+		{
+			memmove(m_ss, s, len * sizeof(TCHAR));
+			m_InlineStr = true;
+		}
+		else
+		{
+			m_s = DupString(s);
+			m_InlineStr = false;
+		}
+	}
+
+	// enum strings are kept in a single block: the comma-delimited list as given, followed by
+	// the same list split into consecutive nul-terminated strings, one per enum value
+	void StoreEnumStrings(const TCHAR *strs)
+	{
+		m_s = nullptr;
+		m_ec = 0;
+
+		if (!strs)
+			return;
+
+		size_t len = _tcslen(strs);
+		TCHAR *b = AllocChars((len + 1) * 2);
+		if (!b)
+			return;
+
+		memcpy(b, strs, (len + 1) * sizeof(TCHAR));
+		TCHAR *split = b + len + 1;
+		memcpy(split, strs, (len + 1) * sizeof(TCHAR));
+
+		if (len)
+		{
+			m_ec = 1;
+			for (size_t i = 0; i < len; i++)
+			{
+				if (split[i] == _T(','))
+				{
+					split[i] = _T('\0');
+					m_ec++;
+				}
+			}
+		}
+
+		m_s = b;
+	}
+
+	void FreeEnumStrings()
+	{
+		if (m_s)
+			FreeChars(m_s, (_tcslen(m_s) + 1) * 2);
+
+		m_s = nullptr;
+		m_ec = 0;
+	}
+
+	// idx must be less than m_ec
+	const TCHAR *EnumString(size_t idx) const
+	{
+		const TCHAR *c = m_s + _tcslen(m_s) + 1;
+		while (idx--)
+			c += _tcslen(c) + 1;
+
+		return c;
+	}
+
+	// sets the name without touching the owner's name index
+	void AssignName(const TCHAR *name)
+	{
+		const TCHAR *n = CNamePool::Get().Intern(name);
+		CNamePool::Get().Release(m_sName);
+		m_sName = n;
+	}
+
+	// names that differ only by case share a key
+	CNamePool::TNameView NameKey() const
+	{
+		return CNamePool::Key(m_sName);
+	}
+
+	size_t RequiredStringLength()
+	{
+		size_t bufsz = 0;
+
+		switch (m_Type)
+		{
+			case PT_ENUM:
+			{
+				// the length of each string plus one character... commas for internal delimiters, colon for last, followed by number
+				TCHAR num[CValueFormatter::MAX_NUMBER_CHARS];
+				bufsz = CValueFormatter::Format((int64_t)m_e, num);
+
+				// the split strings together are exactly as long as the comma-delimited list
+				if (m_ec)
+					bufsz += _tcslen(m_s) + 1;
 				break;
+			}
 
-			case PT_GUID:
-				bufsz = _sctprintf(_T("{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}"), m_g.Data1, m_g.Data2, m_g.Data3,
-					m_g.Data4[0], m_g.Data4[1], m_g.Data4[2], m_g.Data4[3], m_g.Data4[4], m_g.Data4[5], m_g.Data4[6], m_g.Data4[7]);
+			case PT_STRING:
+				bufsz = Str() ? _tcslen(Str()) : 0;
+				break;
+
+			default:
+			{
+				TCHAR buf[CValueFormatter::MAX_VALUE_CHARS];
+				bufsz = FormatValue(buf);
 				break;
+			}
 		}
 
 		return bufsz + 1;
 	}
 
+	// formats any value but a string or enum into buf, which must hold CValueFormatter::MAX_VALUE_CHARS, and returns its length
+	size_t FormatValue(TCHAR *buf) const
+	{
+		if (m_Type == PT_BOOLEAN)
+		{
+			bool b = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_b : m_b;
+
+			const TCHAR *s;
+			switch (m_Aspect)
+			{
+				case PA_BOOL_ONOFF:
+					s = b ? _T("on") : _T("off");
+					break;
+				case PA_BOOL_YESNO:
+					s = b ? _T("yes") : _T("no");
+					break;
+				case PA_BOOL_TRUEFALSE:
+					s = b ? _T("true") : _T("false");
+					break;
+				case PA_BOOL_ABLED:
+					s = b ? _T("enabled") : _T("disabled");
+					break;
+				default:
+					s = b ? _T("1") : _T("0");
+					break;
+			}
+
+			_tcscpy_s(buf, CValueFormatter::MAX_VALUE_CHARS, s);
+			return _tcslen(buf);
+		}
+
+		if ((m_Type == PT_NONE) || (m_Type == PT_STRING) || (m_Type == PT_ENUM) || (m_Type >= PT_NUMTYPES))
+		{
+			buf[0] = _T('\0');
+			return 0;
+		}
+
+		return CValueFormatter::FormatValue(m_Type, ValueAddress(), buf);
+	}
+
 	virtual const TCHAR *GetName() const
 	{
-		return m_sName.c_str();
+		return m_sName ? m_sName : _T("");
 	}
 
 	virtual void SetName(const TCHAR *name)
 	{
-		m_sName = name;
+		// the owner's name index is keyed by the current name, so pull it out before changing it
+		if (m_pOwner)
+			m_pOwner->UnindexName(this);
+
+		AssignName(name);
+
+		if (m_pOwner)
+			m_pOwner->IndexName(this);
+
+		Touch();
 	}
 
 	virtual FOURCHARCODE GetID() const
@@ -258,19 +575,15 @@ public:
 		switch (m_Type)
 		{
 			case PT_ENUM:
-				if (m_es && !m_Flags.IsSet(PROPFLAG_ENUMPROVIDER))
-				{
-					delete m_es;
-					m_es = nullptr;
-				}
-				// drop through to clean up the string also...
+				if (!m_Flags.IsSet(PROPFLAG_ENUMPROVIDER))
+					FreeEnumStrings();
+				break;
 
 			case PT_STRING:
-				if (m_s)
-				{
-					free(m_s);
-					m_s = nullptr;
-				}
+				if (!m_InlineStr)
+					FreeString(m_s);
+				m_s = nullptr;
+				m_InlineStr = false;
 				break;
 
 			default:
@@ -284,7 +597,108 @@ public:
 
 	virtual void Release()
 	{
-		delete this;
+		// the memory for a batched property goes back with the rest of its block
+		if (m_Batched)
+		{
+			this->~CProperty();
+			return;
+		}
+
+		CPropertyArena *arena = m_pOwner ? m_pOwner->m_pArena : nullptr;
+		if (arena)
+		{
+			this->~CProperty();
+			arena->Free(this, sizeof(CProperty));
+		}
+		else
+			delete this;
+	}
+
+	// marks the property as changed for delta serialization
+	void Touch()
+	{
+		if (m_pOwner)
+			m_Stamp = ++m_pOwner->m_Stamp;
+	}
+
+	// marks the property as changed and tells the owner's listener about it
+	void Changed()
+	{
+		Touch();
+
+		if (m_pOwner && m_pOwner->m_pListener)
+			m_pOwner->m_pListener->PropertyChanged(this);
+	}
+
+	// gives a new property its initial value, aspect and flags
+	void SetFromDesc(const IPropertySet::SPropertyDesc &desc)
+	{
+		static const uint64_t zero[sizeof(TMat4x4F) / sizeof(uint64_t)] = {0};
+		const void *v = desc.value ? desc.value : zero;
+
+		switch (desc.type)
+		{
+			case PT_STRING:
+				SetString(desc.value ? (const TCHAR *)desc.value : _T(""));
+				break;
+
+			case PT_INT:
+				SetInt(*(const int64_t *)v);
+				break;
+
+			case PT_INT_V2:
+				SetVec2I(*(const TVec2I *)v);
+				break;
+
+			case PT_INT_V3:
+				SetVec3I(*(const TVec3I *)v);
+				break;
+
+			case PT_INT_V4:
+				SetVec4I(*(const TVec4I *)v);
+				break;
+
+			case PT_FLOAT:
+				SetFloat(*(const float *)v);
+				break;
+
+			case PT_FLOAT_V2:
+				SetVec2F(*(const TVec2F *)v);
+				break;
+
+			case PT_FLOAT_V3:
+				SetVec3F(*(const TVec3F *)v);
+				break;
+
+			case PT_FLOAT_V4:
+				SetVec4F(*(const TVec4F *)v);
+				break;
+
+			case PT_GUID:
+				SetGUID(*(const GUID *)v);
+				break;
+
+			case PT_ENUM:
+				SetEnumStrings((const TCHAR *)desc.value);
+				break;
+
+			case PT_BOOLEAN:
+				SetBool(*(const bool *)v);
+				break;
+
+			case PT_FLOAT_MAT3X3:
+				SetMat3x3F((const TMat3x3F *)v);
+				break;
+
+			case PT_FLOAT_MAT4X4:
+				SetMat4x4F((const TMat4x4F *)v);
+				break;
+		}
+
+		SetAspect(desc.aspect);
+
+		// set last so that locking flags don't get in the way of the above
+		m_Flags.Set(desc.flags & ~(PROPFLAG_REFERENCE | PROPFLAG_ENUMPROVIDER));
 	}
 
 	virtual PROPERTY_TYPE GetType() const
@@ -300,6 +714,22 @@ public:
 		if (newtype == m_Type)
 			return true;
 
+		// strings are parsed as the new type, and report whether they held exactly one value of it
+		if (m_Type == PT_STRING)
+		{
+			bool wellformed;
+			if (newtype == PT_BOOLEAN)
+			{
+				bool b;
+				wellformed = CValueParser::ParseBool(StrSpan(), b);
+				SetBool(b);
+				return wellformed;
+			}
+
+			if (SetValueFromText(this, newtype, StrSpan(), &wellformed))
+				return wellformed;
+		}
+
 		switch (newtype)
 		{
 			case PT_BOOLEAN:
@@ -320,14 +750,6 @@ public:
 			{
 				switch (m_Type)
 				{
-					case PT_STRING:
-					{
-						TVec2I v;
-						AsVec2I(&v);
-						SetVec2I(v);
-						break;
-					}
-
 					case PT_FLOAT:
 					{
 						SetVec2I(props::TVec2I(int64_t(m_v2f.x)));
@@ -359,14 +781,6 @@ public:
 			{
 				switch (m_Type)
 				{
-					case PT_STRING:
-					{
-						TVec3I v;
-						AsVec3I(&v);
-						SetVec3I(v);
-						break;
-					}
-
 					case PT_FLOAT:
 					{
 						SetVec3I(props::TVec3I(int64_t(m_v3f.x)));
@@ -404,14 +818,6 @@ public:
 			{
 				switch (m_Type)
 				{
-					case PT_STRING:
-					{
-						TVec4I v;
-						AsVec4I(&v);
-						SetVec4I(v);
-						break;
-					}
-
 					case PT_FLOAT_V4:
 					{
 						SetVec4I(props::TVec4I(int64_t(m_v4f.x), int64_t(m_v4f.y), int64_t(m_v4f.z), int64_t(m_v4f.w)));
@@ -444,14 +850,6 @@ public:
 			{
 				switch (m_Type)
 				{
-					case PT_STRING:
-					{
-						TVec2F v;
-						AsVec2F(&v);
-						SetVec2F(v);
-						break;
-					}
-
 					case PT_INT:
 					{
 						SetVec2F(props::TVec2F(float(m_i)));
@@ -483,14 +881,6 @@ public:
 			{
 				switch (m_Type)
 				{
-					case PT_STRING:
-					{
-						TVec3F v;
-						AsVec3F(&v);
-						SetVec3F(v);
-						break;
-					}
-
 					case PT_INT:
 					{
 						SetVec3F(props::TVec3F(float(m_i)));
@@ -528,14 +918,6 @@ public:
 			{
 				switch (m_Type)
 				{
-					case PT_STRING:
-					{
-						TVec4F v;
-						AsVec4F(&v);
-						SetVec4F(v);
-						break;
-					}
-
 					case PT_INT_V4:
 					{
 						SetVec4F(props::TVec4F(float(m_v4i.x), float(m_v4i.y), float(m_v4i.z), float(m_v4i.w)));
@@ -558,19 +940,33 @@ public:
 
 			case PT_STRING:
 			{
+				// everything but an enum fits a fixed buffer, so it's formatted once, straight into it
+				if (m_Type != PT_ENUM)
+				{
+					TCHAR buf[CValueFormatter::MAX_VALUE_CHARS];
+					FormatValue(buf);
+
+					Reset();
+
+					StoreString(buf);
+					break;
+				}
+
 				size_t bufsz = RequiredStringLength();
 
 				if (bufsz > 0)
 				{
-					bufsz += sizeof(TCHAR);
-					bufsz *= sizeof(TCHAR);
-					TCHAR *buf = (TCHAR *)malloc(bufsz);
-					AsString(buf, bufsz);
+					TCHAR *buf = (TCHAR *)_alloca((bufsz + 1) * sizeof(TCHAR));
+					buf[0] = _T('\0');
 
-					if ((m_Type == PT_STRING) && m_s)
-						free(m_s);
+					// copy out before Reset, since AsString may hand back our own enum storage
+					const TCHAR *s = AsString(buf, bufsz + 1);
+					if (s != buf)
+						_tcscpy_s(buf, bufsz + 1, s ? s : _T(""));
 
-					m_s = buf;
+					Reset();
+
+					StoreString(buf);
 				}
 				else
 				{
@@ -592,21 +988,18 @@ public:
 			{
 				if (m_Type == PT_STRING)
 				{
-					TCHAR *c = _tcsrchr(m_s, _T(':'));
-					size_t v = 0;
-					if (c)
+					// split a copy; the string storage is released when the enum strings are set
+					tstring tmp = Str() ? Str() : _T("");
+					int64_t v = 0;
+					size_t c = tmp.rfind(_T(':'));
+					if (c != tstring::npos)
 					{
-						*c = _T('\0');
-						c++;
-#if defined(_M_X64)
-						v = _ttoi64(c);
-#else
-						v = _ttoi(c);
-#endif
+						STextSpan num = {tmp.c_str() + c + 1, tmp.length() - c - 1};
+						CValueParser::ParseInts(num, &v, 1);
+						tmp.resize(c);
 					}
-					tstring tmp = m_s;
 					SetEnumStrings(tmp.c_str());
-					SetEnumVal(v);
+					SetEnumVal((size_t)v);
 				}
 				break;
 			}
@@ -625,7 +1018,10 @@ public:
 	virtual void SetAspect(PROPERTY_ASPECT aspect)
 	{
 		if (!m_Flags.IsSet(PROPFLAG(ASPECTLOCKED)))
+		{
 			m_Aspect = aspect;
+			Touch();
+		}
 	}
 
 	virtual void SetInt(int64_t val)
@@ -641,7 +1037,7 @@ public:
 		else
 			*p_i = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetVec2I(const TVec2I &val)
@@ -657,7 +1053,7 @@ public:
 		else
 			*p_v2i = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetVec3I(const TVec3I &val)
@@ -673,7 +1069,7 @@ public:
 		else
 			*p_v3i = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetVec4I(const TVec4I &val)
@@ -689,7 +1085,7 @@ public:
 		else
 			*p_v4i = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetFloat(float val)
@@ -705,7 +1101,7 @@ public:
 		else
 			*p_f = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetVec2F(const TVec2F &val)
@@ -721,7 +1117,7 @@ public:
 		else
 			*p_v2f = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetVec3F(const TVec3F &val)
@@ -737,7 +1133,7 @@ public:
 		else
 			*p_v3f = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetVec4F(const TVec4F &val)
@@ -753,7 +1149,7 @@ public:
 		else
 			*p_v4f = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetMat3x3F(const TMat3x3F *val)
@@ -769,7 +1165,7 @@ public:
 		else
 			*p_m3x3f = *val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetMat4x4F(const TMat4x4F *val)
@@ -785,12 +1181,12 @@ public:
 		else
 			*p_m4x4f = *val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetString(const TCHAR *val)
 	{
-		if ((m_Type == PT_STRING) && !_tcsicmp(val, m_s))
+		if ((m_Type == PT_STRING) && !_tcsicmp(val, Str()))
 			return;
 
 		Reset();
@@ -798,10 +1194,10 @@ public:
 		m_Type = PT_STRING;
 		if (val)
 		{
-			m_s = _tcsdup(val);
+			StoreString(val);
 		}
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetGUID(GUID val)
@@ -817,7 +1213,7 @@ public:
 		else
 			*p_g = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetBool(bool val)
@@ -833,7 +1229,7 @@ public:
 		else
 			*p_b = val;
 
-		if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual void SetEnumProvider(const IEnumProvider *pep)
@@ -848,6 +1244,8 @@ public:
 			m_Flags.Clear(PROPFLAG_ENUMPROVIDER);
 
 		m_pep = pep;
+
+		Touch();
 	}
 
 	virtual const IEnumProvider *GetEnumProvider() const
@@ -866,39 +1264,11 @@ public:
 
 		m_Flags.Clear(PROPFLAG_ENUMPROVIDER);
 
-		m_es = new TStringDeque();
-		if (!m_es)
-			return;
-
-		if (strs)
-		{
-			m_s = _tcsdup(strs);
-			if (!m_s)
-				return;
-
-			size_t len = _tcslen(strs);
-			TCHAR *s = (TCHAR *)_alloca((len + 1) * sizeof(TCHAR));
-			if (s)
-			{
-				_tcscpy_s(s, len + 1, strs);
-
-				TCHAR *c = s + len - 1;
-				while (c >= s)
-				{
-					while ((*c != _T(',')) && (c >= s))
-					{
-						c--;
-					}
-
-					if (c > s)
-						*c = _T('\0');
-
-					m_es->push_front(c + 1);
-				}
-			}
-		}
+		StoreEnumStrings(strs);
 
 		m_e = 0;
+
+		Touch();
 	}
 
 	virtual bool SetEnumVal(size_t val)
@@ -915,20 +1285,18 @@ public:
 			{
 				m_e = val;
 
-				if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+				Changed();
 
 				return true;
 			}
 		}
 		else
 		{
-			assert(m_es);
-
-			if (val < m_es->size())
+			if (val < m_ec)
 			{
 				m_e = val;
 
-				if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+				Changed();
 
 				return true;
 			}
@@ -953,7 +1321,7 @@ public:
 				{
 					m_e = i;
 
-					if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+					Changed();
 
 					return true;
 				}
@@ -961,16 +1329,14 @@ public:
 		}
 		else
 		{
-			assert(m_es);
-
-			size_t val = 0;
-			for (TStringDeque::const_iterator it = m_es->cbegin(), last_it = m_es->cend(); it != last_it; it++, val++)
+			const TCHAR *c = m_ec ? EnumString(0) : nullptr;
+			for (size_t val = 0; val < m_ec; c += _tcslen(c) + 1, val++)
 			{
-				if (!_tcsicmp(it->c_str(), s))
+				if (!_tcsicmp(c, s))
 				{
 					m_e = val;
 
-					if (m_pOwner && m_pOwner->m_pListener) m_pOwner->m_pListener->PropertyChanged(this);
+					Changed();
 
 					return true;
 				}
@@ -991,16 +1357,16 @@ public:
 					return m_pep->GetValue(this, idx, ret, retsize);
 				}
 			}
-			else if ((m_es != nullptr) && (idx < m_es->size()))
+			else if (idx < m_ec)
 			{
-				tstring &t = m_es->at(idx);
+				const TCHAR *t = EnumString(idx);
 				if (ret && retsize)
 				{
-					_tcsnccpy_s(ret, retsize, t.c_str(), retsize);
+					_tcsnccpy_s(ret, retsize, t, retsize);
 					return ret;
 				}
 
-				return m_es->at(idx).c_str();
+				return t;
 			}
 		}
 
@@ -1034,8 +1400,7 @@ public:
 			}
 			else
 			{
-				if (m_es)
-					return m_es->size();
+				return m_ec;
 			}
 		}
 
@@ -1150,8 +1515,7 @@ public:
 
 		SetAspect(pprop->GetAspect());
 
-		if (m_pOwner->m_pListener)
-			m_pOwner->m_pListener->PropertyChanged(this);
+		Changed();
 	}
 
 	virtual int64_t AsInt(int64_t *ret) const
@@ -1163,7 +1527,7 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				*ret = m_s ? (int64_t)_tstoi64(m_s) : 0;
+				CValueParser::ParseInts(StrSpan(), ret, 1);
 				break;
 
 			case PT_BOOLEAN:
@@ -1205,9 +1569,12 @@ public:
 					}
 					*ret = (int64_t)(RGB(r, g, b));
 				}
+				else
+					*ret = 0;
 				break;
 
 			case PT_GUID:
+			default:
 				*ret = 0;
 				break;
 
@@ -1231,7 +1598,8 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				_stscanf_s(m_s, _T("%I64d,%I64d"), &ret->x, &ret->y);
+				if (ret)
+					CValueParser::ParseInts(StrSpan(), ret->v, 2);
 				break;
 
 			case PT_INT:
@@ -1276,7 +1644,8 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				_stscanf_s(m_s, _T("%I64d,%I64d,%I64d"), &ret->x, &ret->y, &ret->z);
+				if (ret)
+					CValueParser::ParseInts(StrSpan(), ret->v, 3);
 				break;
 
 			case PT_INT:
@@ -1331,7 +1700,8 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				_stscanf_s(m_s, _T("%I64d,%I64d,%I64d,%I64d"), &ret->x, &ret->y, &ret->z, &ret->w);
+				if (ret)
+					CValueParser::ParseInts(StrSpan(), ret->v, 4);
 				break;
 
 			case PT_INT:
@@ -1400,7 +1770,7 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				*ret = (float)_tstof(m_s);
+				CValueParser::ParseFloats(StrSpan(), ret, 1);
 				break;
 
 			case PT_BOOLEAN:
@@ -1425,6 +1795,7 @@ public:
 				break;
 
 			case PT_GUID:
+			default:
 				*ret = 0.0f;
 				break;
 		}
@@ -1437,7 +1808,8 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				_stscanf_s(m_s, _T("%f,%f"), &ret->x, &ret->y);
+				if (ret)
+					CValueParser::ParseFloats(StrSpan(), ret->v, 2);
 				break;
 
 			case PT_INT:
@@ -1508,7 +1880,8 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				_stscanf_s(m_s, _T("%f,%f,%f"), &ret->x, &ret->y, &ret->z);
+				if (ret)
+					CValueParser::ParseFloats(StrSpan(), ret->v, 3);
 				break;
 
 			case PT_INT:
@@ -1576,7 +1949,8 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-				_stscanf_s(m_s, _T("%f,%f,%f,%f"), &ret->x, &ret->y, &ret->z, &ret->w);
+				if (ret)
+					CValueParser::ParseFloats(StrSpan(), ret->v, 4);
 				break;
 
 			case PT_INT:
@@ -1651,6 +2025,13 @@ public:
 			return ret ? ret : (!m_Flags.IsSet(PROPFLAG_REFERENCE) ? &m_m3x3f : p_m3x3f);
 		}
 
+		// there's nowhere to keep a matrix parsed from a string unless one is given
+		if ((m_Type == PT_STRING) && ret)
+		{
+			CValueParser::ParseMatrix(StrSpan(), *ret);
+			return ret;
+		}
+
 		return nullptr;
 	}
 
@@ -1669,6 +2050,12 @@ public:
 			return ret ? ret : (!m_Flags.IsSet(PROPFLAG_REFERENCE) ? &m_m4x4f : p_m4x4f);
 		}
 
+		if ((m_Type == PT_STRING) && ret)
+		{
+			CValueParser::ParseMatrix(StrSpan(), *ret);
+			return ret;
+		}
+
 		return nullptr;
 	}
 
@@ -1677,7 +2064,7 @@ public:
 		if (m_Type == PT_STRING)
 		{
 			if (!ret || (retsize == 0))
-				return m_s;
+				return Str();
 		}
 
 		if (m_Type == PT_ENUM)
@@ -1694,96 +2081,28 @@ public:
 			}
 			else
 			{
-				if (m_es)
-				{
-					if ((!ret || (retsize == 0)) && (m_e < m_es->size()))
-						return m_es->at(m_e).c_str();
-					else
-						return m_s ? m_s : _T("");
-				}
+				if ((!ret || (retsize == 0)) && (m_e < m_ec))
+					return EnumString((size_t)m_e);
+				else
+					return m_s ? m_s : _T("");
 			}
 		}
 
 		if (retsize > 0)
 		{
-			switch (m_Type)
+			if (m_Type == PT_STRING)
 			{
-				case PT_STRING:
-					_tcsncpy_s(ret, retsize, m_s ? m_s : _T(""), retsize);
-					break;
-
-				case PT_BOOLEAN:
-					switch (m_Aspect)
-					{
-						case PA_BOOL_ONOFF:
-							_tcscpy_s(ret, retsize, m_b ? _T("on") : _T("off"));
-							break;
-						case PA_BOOL_YESNO:
-							_tcscpy_s(ret, retsize, m_b ? _T("yes") : _T("no"));
-							break;
-						case PA_BOOL_TRUEFALSE:
-							_tcscpy_s(ret, retsize, m_b ? _T("true") : _T("false"));
-							break;
-						case PA_BOOL_ABLED:
-							_tcscpy_s(ret, retsize, m_b ? _T("enabled") : _T("disabled"));
-							break;
-						default:
-							_tcscpy_s(ret, retsize, m_b ? _T("1") : _T("0"));
-							break;
-					}
-					break;
-
-				case PT_INT:
-					_sntprintf_s(ret, retsize, retsize, _T("%I64d"), m_i);
-					break;
-
-				case PT_INT_V2:
-					_sntprintf_s(ret, retsize, retsize, _T("%I64d,%I64d"), m_v2i.x, m_v2i.y);
-					break;
-
-				case PT_INT_V3:
-					_sntprintf_s(ret, retsize, retsize, _T("%I64d,%I64d,%I64d"), m_v3i.x, m_v3i.y, m_v3i.z);
-					break;
-
-				case PT_INT_V4:
-					_sntprintf_s(ret, retsize, retsize, _T("%I64d,%I64d,%I64d,%I64d"), m_v4i.x, m_v4i.y, m_v4i.z, m_v4i.w);
-					break;
-
-				case PT_FLOAT:
-					_sntprintf_s(ret, retsize, retsize, _T("%f"), m_f);
-					break;
-
-				case PT_FLOAT_V2:
-					_sntprintf_s(ret, retsize, retsize, _T("%f,%f"), m_v2f.x, m_v2f.y);
-					break;
-
-				case PT_FLOAT_V3:
-					_sntprintf_s(ret, retsize, retsize, _T("%f,%f,%f"), m_v3f.x, m_v3f.y, m_v3f.z);
-					break;
-
-				case PT_FLOAT_V4:
-					_sntprintf_s(ret, retsize, retsize, _T("%f,%f,%f,%f"), m_v4f.x, m_v4f.y, m_v4f.z, m_v4f.w);
-					break;
-
-				case PT_FLOAT_MAT3X3:
-					_sntprintf_s(ret, retsize, retsize, _T("%f,%f,%f,%f,%f,%f,%f,%f,%f"),
-						m_m3x3f.m[0].x, m_m3x3f.m[0].y, m_m3x3f.m[0].z,
-						m_m3x3f.m[1].x, m_m3x3f.m[1].y, m_m3x3f.m[1].z,
-						m_m3x3f.m[2].x, m_m3x3f.m[2].y, m_m3x3f.m[2].z);
-					break;
-
-				case PT_FLOAT_MAT4X4:
-					_sntprintf_s(ret, retsize, retsize, _T("%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f"),
-						m_m4x4f.m[0].x, m_m4x4f.m[0].y, m_m4x4f.m[0].z, m_m4x4f.m[0].w,
-						m_m4x4f.m[1].x, m_m4x4f.m[1].y, m_m4x4f.m[1].z, m_m4x4f.m[1].w,
-						m_m4x4f.m[2].x, m_m4x4f.m[2].y, m_m4x4f.m[2].z, m_m4x4f.m[2].w,
-						m_m4x4f.m[3].x, m_m4x4f.m[3].y, m_m4x4f.m[3].z, m_m4x4f.m[3].w);
-					break;
-
-				case PT_GUID:
-					_sntprintf_s(ret, retsize, retsize, _T("{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}"), m_g.Data1, m_g.Data2, m_g.Data3,
-						m_g.Data4[0], m_g.Data4[1], m_g.Data4[2], m_g.Data4[3], m_g.Data4[4], m_g.Data4[5], m_g.Data4[6], m_g.Data4[7]);
-					break;
+				_tcsncpy_s(ret, retsize, Str() ? Str() : _T(""), retsize);
+			}
+			else if (retsize >= CValueFormatter::MAX_VALUE_CHARS)
+			{
+				FormatValue(ret);
+			}
+			else
+			{
+				TCHAR buf[CValueFormatter::MAX_VALUE_CHARS];
+				FormatValue(buf);
+				_tcsncpy_s(ret, retsize, buf, _TRUNCATE);
 			}
 		}
 
@@ -1802,24 +2121,8 @@ public:
 		switch (m_Type)
 		{
 			case PT_STRING:
-			{
-				int d[11];
-				_sntscanf_s(m_s, _tcslen(m_s) * sizeof(TCHAR), _T("{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}"), &d[0], &d[1], &d[2],
-					&d[3], &d[4], &d[5], &d[6], &d[7], &d[8], &d[9], &d[10]);
-
-				ret->Data1 = d[0];
-				ret->Data2 = d[1];
-				ret->Data3 = d[2];
-				ret->Data4[0] = d[3];
-				ret->Data4[1] = d[4];
-				ret->Data4[2] = d[5];
-				ret->Data4[3] = d[6];
-				ret->Data4[4] = d[7];
-				ret->Data4[5] = d[8];
-				ret->Data4[6] = d[9];
-				ret->Data4[7] = d[10];
+				CValueParser::ParseGUID(StrSpan(), *ret);
 				break;
-			}
 
 			case PT_INT:
 				break;
@@ -1861,206 +2164,127 @@ public:
 		}
 		else if (m_Type == PT_STRING)
 		{
-			if (!_tcsicmp(m_s, _T("0")) || !_tcsicmp(m_s, _T("false")) || !_tcsicmp(m_s, _T("no")) || !_tcsicmp(m_s, _T("off")) || !_tcsicmp(m_s, _T("disabled")))
-				*ret = false;
-			else if (!_tcsicmp(m_s, _T("1")) || !_tcsicmp(m_s, _T("true")) || !_tcsicmp(m_s, _T("yes")) || !_tcsicmp(m_s, _T("on")) || !_tcsicmp(m_s, _T("enabled")))
-				*ret = true;
+			// anything that isn't one of the boolean words leaves ret as it was
+			bool b;
+			if (CValueParser::ParseBool(StrSpan(), b))
+				*ret = b;
 		}
 
 		return *ret;
 	}
 
-	virtual bool Serialize(SERIALIZE_MODE mode, BYTE *buf, size_t bufsize, size_t *amountused = NULL) const
+	// writes the property in one pass, appending each piece to the sink as it goes
+	bool Serialize(SERIALIZE_MODE mode, IDataSink *psink) const
 	{
-		if (m_Type >= PT_NUMTYPES)
+		// SM_BIN_COMPACT records only make sense as part of a set; see SerializeCompact
+		if ((m_Type >= PT_NUMTYPES) || (mode > SM_BIN_VERBOSE))
 			return false;
 
-		size_t sz = sizeof(BYTE) /*serialization type*/ + sizeof(FOURCHARCODE) /*id*/ + sizeof(BYTE) /*PROPERTY_TYPE*/;
-
-		if (mode >= SM_BIN_TERSE)
-			sz += sizeof(BYTE); /*PROPERTY_ASPECT*/
-
-		if (mode == SM_BIN_VERBOSE)
-			sz += (m_sName.length() + 1) * sizeof(TCHAR);
-
-		switch (m_Type)
-		{
-			case PT_STRING:
-				sz += (_tcslen(m_s) + 1) * sizeof(TCHAR);
-				break;
-
-			case PT_INT:
-				sz += sizeof(int64_t);
-				break;
-
-			case PT_INT_V2:
-				sz += sizeof(TVec2I);
-				break;
-
-			case PT_INT_V3:
-				sz += sizeof(TVec3I);
-				break;
-
-			case PT_INT_V4:
-				sz += sizeof(TVec4I);
-				break;
-
-			case PT_FLOAT:
-				sz += sizeof(float);
-				break;
-
-			case PT_FLOAT_V2:
-				sz += sizeof(TVec2F);
-				break;
-
-			case PT_FLOAT_V3:
-				sz += sizeof(TVec3F);
-				break;
-
-			case PT_FLOAT_V4:
-				sz += sizeof(TVec4F);
-				break;
-
-			case PT_GUID:
-				sz += sizeof(GUID);
-				break;
+		BYTE hdr[sizeof(BYTE) /*serialization type*/ + sizeof(FOURCHARCODE) /*id*/ + sizeof(BYTE) /*PROPERTY_TYPE*/ + sizeof(BYTE) /*PROPERTY_ASPECT*/];
+		size_t hdrsize = 0;
 
-			case PT_ENUM:
-			{
-				sz += ((m_s ? _tcslen(m_s) : 0) + 1) * sizeof(TCHAR);
-				sz += sizeof(uint64_t);
-				break;
-			}
+		hdr[hdrsize] = BYTE(mode);
+		hdrsize += sizeof(BYTE);
 
-			case PT_BOOLEAN:
-				sz += sizeof(bool);
-				break;
+		memcpy(&hdr[hdrsize], &m_ID, sizeof(FOURCHARCODE));
+		hdrsize += sizeof(FOURCHARCODE);
 
-			case PT_FLOAT_MAT3X3:
-				sz += sizeof(TMat3x3F);
-				break;
+		hdr[hdrsize] = BYTE(m_Type);
+		hdrsize += sizeof(BYTE);
 
-			case PT_FLOAT_MAT4X4:
-				sz += sizeof(TMat4x4F);
-				break;
+		if (mode >= SM_BIN_TERSE)
+		{
+			hdr[hdrsize] = BYTE(m_Aspect);
+			hdrsize += sizeof(BYTE);
 		}
 
-		if (amountused)
-			*amountused = sz;
-
-		if (buf && (bufsize < sz))
+		if (!psink->Write(hdr, hdrsize))
 			return false;
-		else if (!buf)
-			return true;
-
-		*buf = BYTE(mode);
-		buf += sizeof(BYTE);
-
-		*((FOURCHARCODE *)buf) = m_ID;
-		buf += sizeof(FOURCHARCODE);
-
-		*buf = BYTE(m_Type);
-		buf += sizeof(BYTE);
 
-		if (mode >= SM_BIN_TERSE)
+		if (mode == SM_BIN_VERBOSE)
 		{
-			*buf = BYTE(m_Aspect);
-			buf += sizeof(BYTE);
+			if (!psink->Write(GetName(), sizeof(TCHAR) * (_tcslen(GetName()) + 1)))
+				return false;
 		}
 
-		if (mode == SM_BIN_VERBOSE)
+		if (m_Type == PT_ENUM)
 		{
-			memcpy(buf, m_sName.c_str(), sizeof(TCHAR) * (m_sName.length() + 1));
-			buf += sizeof(TCHAR) * (m_sName.length() + 1);
+			const TCHAR *strs = m_s ? m_s : _T("");
+			if (!psink->Write(strs, sizeof(TCHAR) * (_tcslen(strs) + 1)))
+				return false;
 		}
 
+		return SerializeValue(psink);
+	}
+
+	// writes only the value; an enum's strings are left to the caller
+	bool SerializeValue(IDataSink *psink) const
+	{
 		switch (m_Type)
 		{
 			case PT_STRING:
-			{
-				size_t bs = sizeof(TCHAR) * (_tcslen(m_s) + 1);
-				memcpy(buf, m_s, bs);
-				buf += bs;
-				break;
-			}
+				return psink->Write(Str(), sizeof(TCHAR) * (_tcslen(Str()) + 1));
 
 			case PT_INT:
-				*((int64_t *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_i : m_i;
-				buf += sizeof(int64_t);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_i : &m_i, sizeof(m_i));
 
 			case PT_INT_V2:
-				*((TVec2I *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_v2i : m_v2i;
-				buf += sizeof(TVec2I);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_v2i : &m_v2i, sizeof(m_v2i));
 
 			case PT_INT_V3:
-				*((TVec3I *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_v3i : m_v3i;
-				buf += sizeof(TVec3I);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_v3i : &m_v3i, sizeof(m_v3i));
 
 			case PT_INT_V4:
-				*((TVec4I *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_v4i : m_v4i;
-				buf += sizeof(TVec4I);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_v4i : &m_v4i, sizeof(m_v4i));
 
 			case PT_FLOAT:
-				*((float *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_f : m_f;
-				buf += sizeof(float);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_f : &m_f, sizeof(m_f));
 
 			case PT_FLOAT_V2:
-				*((TVec2F *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_v2f : m_v2f;
-				buf += sizeof(TVec2F);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_v2f : &m_v2f, sizeof(m_v2f));
 
 			case PT_FLOAT_V3:
-				*((TVec3F *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_v3f : m_v3f;
-				buf += sizeof(TVec3F);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_v3f : &m_v3f, sizeof(m_v3f));
 
 			case PT_FLOAT_V4:
-				*((TVec4F *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_v4f : m_v4f;
-				buf += sizeof(TVec4F);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_v4f : &m_v4f, sizeof(m_v4f));
 
 			case PT_GUID:
-				*((GUID *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_g : m_g;
-				buf += sizeof(GUID);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_g : &m_g, sizeof(m_g));
 
 			case PT_BOOLEAN:
-				*((bool *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_b : m_b;
-				buf += sizeof(bool);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_b : &m_b, sizeof(m_b));
 
 			case PT_ENUM:
-			{
-				size_t bs;
-
-				bs = ((m_s ? _tcslen(m_s) : 0) + 1) * sizeof(TCHAR);
-				memcpy(buf, m_s ? m_s : _T(""), bs);
-				buf += bs;
-
-				*(uint64_t *)buf = m_e;
-				buf += sizeof(uint64_t);
-				break;
-			}
+				return psink->Write(&m_e, sizeof(uint64_t));
 
 			case PT_FLOAT_MAT3X3:
-				*((TMat3x3F *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_m3x3f : m_m3x3f;
-				buf += sizeof(TMat3x3F);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_m3x3f : &m_m3x3f, sizeof(m_m3x3f));
 
 			case PT_FLOAT_MAT4X4:
-				*((TMat4x4F *)buf) = m_Flags.IsSet(PROPFLAG_REFERENCE) ? *p_m4x4f : m_m4x4f;
-				buf += sizeof(TMat4x4F);
-				break;
+				return psink->Write(m_Flags.IsSet(PROPFLAG_REFERENCE) ? (const void *)p_m4x4f : &m_m4x4f, sizeof(m_m4x4f));
 		}
 
 		return true;
 	}
 
+	// reads a value written by SerializeValue into this (non-reference) property, which must already have the value's type,
+	// and advances buf past it; fails rather than read past end
+	bool DeserializeValue(const BYTE *&buf, const BYTE *end);
+
+	// if buf is null, only the size is reported
+	virtual bool Serialize(SERIALIZE_MODE mode, BYTE *buf, size_t bufsize, size_t *amountused = NULL) const
+	{
+		CFixedDataSink sink(buf, bufsize);
+		if (!Serialize(mode, &sink))
+			return false;
+
+		if (amountused)
+			*amountused = sink.GetSize();
+
+		return (!buf || sink.Fits());
+	}
+
 	virtual bool Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
 	{
 		Reset();
@@ -2092,16 +2316,17 @@ public:
 
 		if (mode == SM_BIN_VERBOSE)
 		{
-			m_sName = (TCHAR *)buf;
-			buf += sizeof(TCHAR) * (m_sName.length() + 1);
+			const TCHAR *name = (TCHAR *)buf;
+			SetName(name);
+			buf += sizeof(TCHAR) * (_tcslen(name) + 1);
 		}
 
 		switch (m_Type)
 		{
 			case PT_STRING:
 			{
-				m_s = _tcsdup((TCHAR *)buf);
-				buf += sizeof(TCHAR) * (_tcslen(m_s) + 1);
+				StoreString((TCHAR *)buf);
+				buf += sizeof(TCHAR) * (_tcslen((TCHAR *)buf) + 1);
 				break;
 			}
 
@@ -2187,14 +2412,13 @@ public:
 
 			case PT_ENUM:
 			{
-				TCHAR *tmp = (*buf != _T('\0')) ? _tcsdup((TCHAR *)buf) : nullptr;
+				const TCHAR *tmp = (*((TCHAR *)buf) != _T('\0')) ? (TCHAR *)buf : nullptr;
 				buf += ((tmp ? _tcslen(tmp) : 0) + 1) * sizeof(TCHAR);
 				if (!m_Flags.IsSet(PROPFLAG_ENUMPROVIDER))
-					SetEnumStrings(tmp);
+					StoreEnumStrings(tmp);
 
 				m_e = *((uint64_t *)buf);
 				buf += sizeof(uint64_t);
-				free(tmp);
 				break;
 			}
 
@@ -2221,41 +2445,265 @@ public:
 		return (size_t(buf - origbuf) <= bufsize) ? true : false;
 	}
 
-	virtual bool IsSameAs(const IProperty *other_prop) const
+	// writes this property as a SM_BIN_COMPACT record: the id, then the type in the low nibble of a byte with the aspect in
+	// its high nibble (or 15 there and the aspect in a byte of its own), then the value. A boolean's value goes to the
+	// writer's bit array instead.
+	void SerializeCompact(CCompactWriter &w) const
 	{
-		if ((!other_prop) || (other_prop->GetID() != m_ID))
-			return false;
-
-		CProperty *p = (CProperty *)other_prop;
+		w.WriteRaw(&m_ID, sizeof(FOURCHARCODE));
 
-		PROPERTY_TYPE other_type = p->GetType();
-
-		if (other_type != m_Type)
-			return false;
+		if (m_Aspect < 0x0F)
+		{
+			w.WriteByte(BYTE(m_Type | (m_Aspect << 4)));
+		}
+		else
+		{
+			w.WriteByte(BYTE(m_Type | 0xF0));
+			w.WriteByte(BYTE(m_Aspect));
+		}
 
-		if ((other_type == PROPERTY_TYPE::PT_STRING) && _tcscmp(p->m_s, m_s))
-			return false;
+		bool ref = m_Flags.IsSet(PROPFLAG_REFERENCE);
 
-		switch (other_type)
+		switch (m_Type)
 		{
-			case PROPERTY_TYPE::PT_BOOLEAN:
-				if (p->m_b != m_b)
-					return false;
+			case PT_STRING:
+				w.WriteString(Str());
 				break;
 
-			case PROPERTY_TYPE::PT_ENUM:
-				if (p->m_e != m_e)
-					return false;
+			case PT_INT:
+				w.WriteSigned(ref ? *p_i : m_i);
 				break;
 
-			case PROPERTY_TYPE::PT_INT:
-				if (p->m_i != m_i)
-					return false;
+			case PT_INT_V2:
+			{
+				const TVec2I &v = ref ? *p_v2i : m_v2i;
+				w.WriteSigned(v.x);
+				w.WriteSigned(v.y);
 				break;
+			}
 
-			case PROPERTY_TYPE::PT_FLOAT:
-				if (p->m_f != m_f)
-					return false;
+			case PT_INT_V3:
+			{
+				const TVec3I &v = ref ? *p_v3i : m_v3i;
+				w.WriteSigned(v.x);
+				w.WriteSigned(v.y);
+				w.WriteSigned(v.z);
+				break;
+			}
+
+			case PT_INT_V4:
+			{
+				const TVec4I &v = ref ? *p_v4i : m_v4i;
+				w.WriteSigned(v.x);
+				w.WriteSigned(v.y);
+				w.WriteSigned(v.z);
+				w.WriteSigned(v.w);
+				break;
+			}
+
+			case PT_FLOAT:
+				w.WriteRaw(ref ? p_f : &m_f, sizeof(float));
+				break;
+
+			case PT_FLOAT_V2:
+				w.WriteRaw(ref ? p_v2f : &m_v2f, sizeof(TVec2F));
+				break;
+
+			case PT_FLOAT_V3:
+				w.WriteRaw(ref ? p_v3f : &m_v3f, sizeof(TVec3F));
+				break;
+
+			case PT_FLOAT_V4:
+				w.WriteRaw(ref ? p_v4f : &m_v4f, sizeof(TVec4F));
+				break;
+
+			case PT_GUID:
+				w.WriteRaw(ref ? p_g : &m_g, sizeof(GUID));
+				break;
+
+			case PT_ENUM:
+				w.WriteString(m_s);
+				w.WriteVarint(m_e);
+				break;
+
+			case PT_BOOLEAN:
+				w.WriteBool(ref ? *p_b : m_b);
+				break;
+
+			case PT_FLOAT_MAT3X3:
+				w.WriteRaw(ref ? p_m3x3f : &m_m3x3f, sizeof(TMat3x3F));
+				break;
+
+			case PT_FLOAT_MAT4X4:
+				w.WriteRaw(ref ? p_m4x4f : &m_m4x4f, sizeof(TMat4x4F));
+				break;
+		}
+	}
+
+	// reads the rest of a SM_BIN_COMPACT record, after the id; the set supplies a boolean's value through StoreBool once
+	// it reaches the bit array
+	bool DeserializeCompact(CCompactReader &r)
+	{
+		Reset();
+
+		BYTE ta = r.ReadByte();
+
+		PROPERTY_TYPE type = PROPERTY_TYPE(ta & 0x0F);
+		BYTE aspect = BYTE(ta >> 4);
+		if (aspect == 0x0F)
+			aspect = r.ReadByte();
+
+		if (!r.OK() || (type >= PT_NUMTYPES) || (aspect >= PA_NUMASPECTS))
+			return false;
+
+		m_Type = type;
+		m_Aspect = PROPERTY_ASPECT(aspect);
+
+		bool ref = m_Flags.IsSet(PROPFLAG_REFERENCE);
+
+		switch (m_Type)
+		{
+			case PT_STRING:
+				StoreString(r.ReadString());
+				break;
+
+			case PT_INT:
+			{
+				int64_t v = r.ReadSigned();
+				*(ref ? p_i : &m_i) = v;
+				break;
+			}
+
+			case PT_INT_V2:
+			{
+				TVec2I v;
+				v.x = r.ReadSigned();
+				v.y = r.ReadSigned();
+				*(ref ? p_v2i : &m_v2i) = v;
+				break;
+			}
+
+			case PT_INT_V3:
+			{
+				TVec3I v;
+				v.x = r.ReadSigned();
+				v.y = r.ReadSigned();
+				v.z = r.ReadSigned();
+				*(ref ? p_v3i : &m_v3i) = v;
+				break;
+			}
+
+			case PT_INT_V4:
+			{
+				TVec4I v;
+				v.x = r.ReadSigned();
+				v.y = r.ReadSigned();
+				v.z = r.ReadSigned();
+				v.w = r.ReadSigned();
+				*(ref ? p_v4i : &m_v4i) = v;
+				break;
+			}
+
+			case PT_FLOAT:
+				r.ReadRaw(ref ? p_f : &m_f, sizeof(float));
+				break;
+
+			case PT_FLOAT_V2:
+				r.ReadRaw(ref ? p_v2f : &m_v2f, sizeof(TVec2F));
+				break;
+
+			case PT_FLOAT_V3:
+				r.ReadRaw(ref ? p_v3f : &m_v3f, sizeof(TVec3F));
+				break;
+
+			case PT_FLOAT_V4:
+				r.ReadRaw(ref ? p_v4f : &m_v4f, sizeof(TVec4F));
+				break;
+
+			case PT_GUID:
+				r.ReadRaw(ref ? p_g : &m_g, sizeof(GUID));
+				break;
+
+			case PT_ENUM:
+			{
+				// stored directly; SetEnumStrings would Reset again, freeing whatever the old type left in m_s
+				const TCHAR *strs = r.ReadString();
+				if (!m_Flags.IsSet(PROPFLAG_ENUMPROVIDER))
+					StoreEnumStrings(*strs ? strs : nullptr);
+
+				m_e = r.ReadVarint();
+				break;
+			}
+
+			case PT_FLOAT_MAT3X3:
+				r.ReadRaw(ref ? p_m3x3f : &m_m3x3f, sizeof(TMat3x3F));
+				break;
+
+			case PT_FLOAT_MAT4X4:
+				r.ReadRaw(ref ? p_m4x4f : &m_m4x4f, sizeof(TMat4x4F));
+				break;
+		}
+
+		return r.OK();
+	}
+
+	// writes this property as a SM_BIN_ALIGNED record: the id, the type and aspect bytes, then the value, each padded to
+	// its natural boundary
+	void SerializeAligned(CAlignedWriter &w) const;
+
+	// reads the rest of a SM_BIN_ALIGNED record, after the id
+	bool DeserializeAligned(CAlignedReader &r);
+
+	void StoreBool(bool val)
+	{
+		if (m_Flags.IsSet(PROPFLAG_REFERENCE))
+			*p_b = val;
+		else
+			m_b = val;
+	}
+
+	// true if pprop belongs to a schema-backed set rather than being a CProperty
+	static bool IsSchemaProperty(const IProperty *pprop);
+
+	virtual bool IsSameAs(const IProperty *other_prop) const
+	{
+		if ((!other_prop) || (other_prop->GetID() != m_ID))
+			return false;
+
+		// schema-backed properties have no CProperty of their own, so let them compare a copy of their value with this
+		if (IsSchemaProperty(other_prop))
+			return other_prop->IsSameAs(this);
+
+		CProperty *p = (CProperty *)other_prop;
+
+		PROPERTY_TYPE other_type = p->GetType();
+
+		if (other_type != m_Type)
+			return false;
+
+		if ((other_type == PROPERTY_TYPE::PT_STRING) && _tcscmp(p->Str(), Str()))
+			return false;
+
+		switch (other_type)
+		{
+			case PROPERTY_TYPE::PT_BOOLEAN:
+				if (p->m_b != m_b)
+					return false;
+				break;
+
+			case PROPERTY_TYPE::PT_ENUM:
+				if (p->m_e != m_e)
+					return false;
+				break;
+
+			case PROPERTY_TYPE::PT_INT:
+				if (p->m_i != m_i)
+					return false;
+				break;
+
+			case PROPERTY_TYPE::PT_FLOAT:
+				if (p->m_f != m_f)
+					return false;
 				break;
 
 			case PROPERTY_TYPE::PT_FLOAT_V2:
@@ -2311,12 +2759,16 @@ public:
 	{
 		if (GetEnumProvider())
 		{
-			TStringDeque *tmp = new TStringDeque();
+			tstring tmp;
 			for (size_t i = 0, maxi = m_pep->GetNumValues(this); i < maxi; i++)
-				tmp->push_back(tstring(m_pep->GetValue(this, i)));
-			m_es = tmp;
+			{
+				if (i)
+					tmp += _T(',');
+				tmp += m_pep->GetValue(this, i);
+			}
 
 			m_Flags.Clear(PROPFLAG_ENUMPROVIDER);
+			StoreEnumStrings(tmp.c_str());
 		}
 
 		if (m_Flags.IsSet(PROPFLAG_REFERENCE))
@@ -2417,14 +2869,22 @@ public:
 };
 
 
-CPropertySet::CPropertySet()
+CPropertySet::CPropertySet(ALLOCATION_MODE mode)
 {
-	m_pListener = nullptr;
+	m_pArena = (mode == AM_ARENA) ? new CPropertyArena() : nullptr;
+
+	m_FreeSlot = NO_SLOT;
+
+	m_Stamp = 0;
+	m_ClearStamp = 0;
+	m_TrackDeletions = false;
 }
 
 CPropertySet::~CPropertySet()
 {
 	DeleteAll();
+
+	delete m_pArena;
 }
 
 void CPropertySet::Release()
@@ -2435,20 +2895,21 @@ void CPropertySet::Release()
 
 IProperty *CPropertySet::CreateProperty(const TCHAR *propname, FOURCHARCODE propid)
 {
-	TPropertyMap::const_iterator pi = m_mapProps.find(propid);
-	if ((pi != m_mapProps.end()) && pi->second)
+	IProperty **pi = m_mapProps.Find(propid);
+	if (pi && *pi)
 	{
 		// if the property already existed, then alert the listener to it's value
 		if (m_pListener)
-			m_pListener->PropertyChanged(pi->second);
+			m_pListener->PropertyChanged(*pi);
 
-		return pi->second;
+		return *pi;
 	}
 
-	CProperty *pprop = new CProperty(this);
+	CProperty *pprop = NewProperty();
 	if (pprop)
 	{
-		pprop->SetName(propname ? propname : _T(""));
+		// not indexed yet, so the name can be assigned directly; AddProperty will index it
+		pprop->AssignName(propname);
 		pprop->SetID(propid);
 
 		AddProperty(pprop);
@@ -2458,6 +2919,61 @@ IProperty *CPropertySet::CreateProperty(const TCHAR *propname, FOURCHARCODE prop
 }
 
 
+size_t CPropertySet::CreateProperties(const SPropertyDesc *descs, size_t count)
+{
+	if (!descs || !count)
+		return 0;
+
+	size_t total = m_Props.size() + count;
+	m_Props.reserve(total);
+	m_Slots.reserve(total);
+	m_mapProps.Reserve(total);
+	m_mapNames.reserve(total);
+
+	SBlock b;
+	b.m_Size = sizeof(CProperty) * count;
+	b.m_pMem = m_pArena ? m_pArena->Alloc(b.m_Size) : malloc(b.m_Size);
+	if (!b.m_pMem)
+		return 0;
+
+	CProperty *block = (CProperty *)b.m_pMem;
+
+	// initial values aren't changes, so the listener doesn't hear about them
+	IPropertyChangeListener *plistener = m_pListener;
+	m_pListener = nullptr;
+
+	size_t created = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const SPropertyDesc &desc = descs[i];
+
+		// as with CreateProperty, an existing property is left alone
+		if (m_mapProps.Find(desc.id))
+			continue;
+
+		CProperty *pprop = new (block + created) CProperty(this);
+		pprop->m_Batched = true;
+		pprop->AssignName(desc.name);
+		pprop->SetID(desc.id);
+		pprop->SetFromDesc(desc);
+
+		AddProperty(pprop);
+		created++;
+	}
+
+	m_pListener = plistener;
+
+	if (created)
+		m_Blocks.push_back(b);
+	else if (m_pArena)
+		m_pArena->Free(b.m_pMem, b.m_Size);
+	else
+		free(b.m_pMem);
+
+	return created;
+}
+
+
 IProperty *CPropertySet::CreateReferenceProperty(const TCHAR *propname, FOURCHARCODE propid, void *addr, IProperty::PROPERTY_TYPE type)
 {
 	// string and enum types are not allowed for reference properties
@@ -2465,10 +2981,10 @@ IProperty *CPropertySet::CreateReferenceProperty(const TCHAR *propname, FOURCHAR
 		return nullptr;
 
 	// reference properties with duplicate IDs are not allowed
-	TPropertyMap::const_iterator pi = m_mapProps.find(propid);
-	if ((pi != m_mapProps.end()) && pi->second)
+	IProperty **pi = m_mapProps.Find(propid);
+	if (pi && *pi)
 	{
-		CProperty *ret = (CProperty *)(pi->second);
+		CProperty *ret = (CProperty *)(*pi);
 
 		// if the property we found isn't a reference property, we need to update the reference values if they're the same type, then internalize the property...
 		if ((type == ret->GetType()) && !ret->Flags().IsSet(PROPFLAG_REFERENCE))
@@ -2542,11 +3058,11 @@ IProperty *CPropertySet::CreateReferenceProperty(const TCHAR *propname, FOURCHAR
 		return ret;
 	}
 
-	CProperty *pprop = new CProperty(this);
+	CProperty *pprop = NewProperty();
 	if (!pprop)
 		return nullptr;
 
-	pprop->m_sName = propname;
+	pprop->AssignName(propname);
 	pprop->m_ID = propid;
 	pprop->m_Flags.Set(PROPFLAG_REFERENCE | props::IProperty::PROPFLAG(props::IProperty::TYPELOCKED));
 	pprop->m_Type = type;
@@ -2607,82 +3123,145 @@ IProperty *CPropertySet::CreateReferenceProperty(const TCHAR *propname, FOURCHAR
 	return pprop;
 }
 
+CProperty *CPropertySet::NewProperty()
+{
+	if (m_pArena)
+	{
+		void *mem = m_pArena->Alloc(sizeof(CProperty));
+		return mem ? new (mem) CProperty(this) : nullptr;
+	}
+
+	return new CProperty(this);
+}
+
 void CPropertySet::AddProperty(IProperty *pprop)
 {
 	if (!pprop)
 		return;
 
+	CProperty *p = (CProperty *)pprop;
+
 	uint32_t propid = pprop->GetID();
-	m_mapProps.insert(TPropertyMapPair(propid, pprop));
-	m_Props.insert(m_Props.end(), pprop);
+	m_mapProps.Insert(propid, pprop);
+
+	if (!m_Deletions.empty())
+		m_Deletions.erase(propid);
+
+	p->m_Pos = (uint32_t)m_Props.size();
+	m_Props.push_back(pprop);
+
+	if (m_FreeSlot != NO_SLOT)
+	{
+		p->m_Handle = m_FreeSlot;
+		m_FreeSlot = m_Slots[m_FreeSlot].m_NextFree;
+	}
+	else
+	{
+		SHandleSlot slot;
+		slot.m_Generation = 1;
+		p->m_Handle = (uint32_t)m_Slots.size();
+		m_Slots.push_back(slot);
+	}
+
+	m_Slots[p->m_Handle].m_pProp = p;
+	m_Slots[p->m_Handle].m_NextFree = NO_SLOT;
+
+	p->m_Stamp = ++m_Stamp;
+
+	IndexName(pprop);
 }
 
 
-void CPropertySet::DeleteProperty(size_t idx)
+void CPropertySet::RemoveProperty(CProperty *pprop)
 {
-	if (idx >= m_Props.size())
-		return;
+	m_mapProps.Erase(pprop->GetID());
 
-	IProperty *pprop = m_Props[idx];
-	if (pprop)
-	{
-		TPropertyArray::iterator pia = m_Props.begin();
-		pia += idx;
-		m_Props.erase(pia);
+	if (m_TrackDeletions)
+		m_Deletions[pprop->GetID()] = ++m_Stamp;
 
-		TPropertyMap::iterator pim = m_mapProps.find(pprop->GetID());
-		m_mapProps.erase(pim);
+	UnindexName(pprop);
 
-		pprop->Release();
-	}
+	// fill the hole with the last property
+	CProperty *plast = (CProperty *)m_Props.back();
+	m_Props[pprop->m_Pos] = plast;
+	plast->m_Pos = pprop->m_Pos;
+	m_Props.pop_back();
+
+	SHandleSlot &slot = m_Slots[pprop->m_Handle];
+	slot.m_pProp = nullptr;
+	if (!++slot.m_Generation)
+		slot.m_Generation = 1;
+	slot.m_NextFree = m_FreeSlot;
+	m_FreeSlot = pprop->m_Handle;
+
+	pprop->Release();
 }
 
-void CPropertySet::DeletePropertyById(FOURCHARCODE propid)
+
+// every property in a CPropertySet is a CProperty, so its name is pooled
+void CPropertySet::IndexName(IProperty *pprop)
 {
-	TPropertyMap::iterator j = m_mapProps.find(propid);
-	if (j != m_mapProps.end())
-		m_mapProps.erase(j);
+	m_mapNames.insert(TPropertyNameMap::value_type(((CProperty *)pprop)->NameKey(), pprop));
+}
 
-	TPropertyArray::const_iterator e = m_Props.end();
-	for (TPropertyArray::iterator i = m_Props.begin(); i != e; i++)
-	{
-		IProperty *pprop = *i;
 
-		if (pprop->GetID() == propid)
+void CPropertySet::UnindexName(IProperty *pprop)
+{
+	std::pair<TPropertyNameMap::iterator, TPropertyNameMap::iterator> r = m_mapNames.equal_range(((CProperty *)pprop)->NameKey());
+	for (TPropertyNameMap::iterator it = r.first; it != r.second; it++)
+	{
+		if (it->second == pprop)
 		{
-			m_Props.erase(i);
-
-			pprop->Release();
+			m_mapNames.erase(it);
 			break;
 		}
 	}
 }
 
 
+void CPropertySet::DeleteProperty(size_t idx)
+{
+	if (idx >= m_Props.size())
+		return;
+
+	RemoveProperty((CProperty *)m_Props[idx]);
+}
+
+void CPropertySet::DeletePropertyById(FOURCHARCODE propid)
+{
+	IProperty *const *pi = m_mapProps.Find(propid);
+	if (pi)
+		RemoveProperty((CProperty *)*pi);
+}
+
+
 void CPropertySet::DeletePropertyByName(const TCHAR *propname)
 {
-	TPropertyArray::const_iterator e = m_Props.end();
-	for (TPropertyArray::iterator i = m_Props.begin(); i != e; i++)
-	{
-		IProperty *pprop = *i;
+	if (!propname)
+		return;
 
-		if (!_tcsicmp(pprop->GetName(), propname))
-		{
-			TPropertyMap::iterator j = m_mapProps.find(pprop->GetID());
-			if (j != m_mapProps.end())
-				m_mapProps.erase(j);
+	TPropertyNameMap::iterator n = m_mapNames.find(CNamePool::CLookupKey(propname));
+	if (n == m_mapNames.end())
+		return;
+
+	RemoveProperty((CProperty *)n->second);
+}
 
-			m_Props.erase(i);
 
-			pprop->Release();
-			return;
-		}
-	}
+void CPropertySet::DeletePropertyByHandle(PropertyHandle handle)
+{
+	CProperty *pprop = (CProperty *)GetPropertyByHandle(handle);
+	if (pprop)
+		RemoveProperty(pprop);
 }
 
 
 void CPropertySet::DeleteAll()
 {
+	// properties still need to be destroyed one by one, but arena memory is reclaimed in bulk afterward
+	if (m_pArena)
+		m_pArena->BeginRelease();
+
 	for (uint32_t i = 0; i < m_Props.size(); i++)
 	{
 		IProperty *pprop = m_Props[i];
@@ -2690,7 +3269,40 @@ void CPropertySet::DeleteAll()
 	}
 
 	m_Props.clear();
-	m_mapProps.clear();
+	m_mapProps.Clear();
+	m_mapNames.clear();
+
+	// arena blocks from the slabs go back with the Reset below
+	for (TBlockArray::iterator it = m_Blocks.begin(), last_it = m_Blocks.end(); it != last_it; it++)
+	{
+		if (m_pArena)
+			m_pArena->Free(it->m_pMem, it->m_Size);
+		else
+			free(it->m_pMem);
+	}
+	m_Blocks.clear();
+
+	m_Deletions.clear();
+	m_ClearStamp = ++m_Stamp;
+
+	// every outstanding handle goes stale and all slots return to the free list
+	m_FreeSlot = NO_SLOT;
+	for (size_t i = m_Slots.size(); i-- > 0; )
+	{
+		SHandleSlot &slot = m_Slots[i];
+		if (slot.m_pProp)
+		{
+			slot.m_pProp = nullptr;
+			if (!++slot.m_Generation)
+				slot.m_Generation = 1;
+		}
+
+		slot.m_NextFree = m_FreeSlot;
+		m_FreeSlot = (uint32_t)i;
+	}
+
+	if (m_pArena)
+		m_pArena->Reset();
 }
 
 
@@ -2711,32 +3323,54 @@ IProperty *CPropertySet::GetProperty(size_t idx) const
 
 IProperty *CPropertySet::GetPropertyById(props::FOURCHARCODE propid) const
 {
-	TPropertyMap::const_iterator j = m_mapProps.find(propid);
-	if (j != m_mapProps.end())
-		return j->second;
+	IProperty *const *pi = m_mapProps.Find(propid);
+	if (pi)
+		return *pi;
 
 	return NULL;
 }
 
 
-IProperty *CPropertySet::GetPropertyByName(const TCHAR *propname) const
+PropertyHandle CPropertySet::GetPropertyHandle(FOURCHARCODE propid) const
 {
-	TPropertyArray::const_iterator e = m_Props.end();
-	for (TPropertyArray::const_iterator i = m_Props.begin(); i != e; i++)
-	{
-		IProperty *pprop = *i;
+	PropertyHandle ret = {0, 0};
 
-		if (!_tcsicmp(pprop->GetName(), propname))
-			return pprop;
+	CProperty *pprop = (CProperty *)GetPropertyById(propid);
+	if (pprop)
+	{
+		ret.index = pprop->m_Handle;
+		ret.generation = m_Slots[pprop->m_Handle].m_Generation;
 	}
 
+	return ret;
+}
+
+
+IProperty *CPropertySet::GetPropertyByHandle(PropertyHandle handle) const
+{
+	if ((handle.index < m_Slots.size()) && (m_Slots[handle.index].m_Generation == handle.generation))
+		return m_Slots[handle.index].m_pProp;
+
 	return NULL;
 }
 
 
-CPropertySet &CPropertySet::operator =(IPropertySet *propset)
+IProperty *CPropertySet::GetPropertyByName(const TCHAR *propname) const
 {
-	DeleteAll();
+	if (!propname)
+		return NULL;
+
+	TPropertyNameMap::const_iterator n = m_mapNames.find(CNamePool::CLookupKey(propname));
+	if (n != m_mapNames.end())
+		return n->second;
+
+	return NULL;
+}
+
+
+CPropertySet &CPropertySet::operator =(IPropertySet *propset)
+{
+	DeleteAll();
 
 	for (uint32_t i = 0; i < propset->GetPropertyCount(); i++)
 	{
@@ -2766,7 +3400,7 @@ CPropertySet &CPropertySet::operator +=(IPropertySet *propset)
 }
 
 
-void CPropertySet::AppendPropertySet(const IPropertySet *propset, bool overwrite_flags)
+void CPropertySetBase::AppendPropertySet(const IPropertySet *propset, bool overwrite_flags)
 {
 	for (uint32_t i = 0; i < propset->GetPropertyCount(); i++)
 	{
@@ -2787,37 +3421,304 @@ void CPropertySet::AppendPropertySet(const IPropertySet *propset, bool overwrite
 	}
 }
 
-bool CPropertySet::Serialize(IProperty::SERIALIZE_MODE mode, BYTE *buf, size_t bufsize, size_t *amountused) const
+// SerializeChunked streams are a short of -2 (a marker no other serialized set begins with) and a 32-bit property count,
+// then chunks, each a 32-bit size followed by that many bytes of an ordinary serialized set, and finally a size of 0.
+// Chunk sizes never exceed MAX_CHUNK_BYTES, so a reader can reject a larger one before allocating anything for it
+class CChunkWriter
 {
-	size_t used = sizeof(short);
+protected:
+	IDataSink *m_pSink;
+	IProperty::SERIALIZE_MODE m_Mode;
+	size_t m_ChunkSize;
+	bool m_OK;
+
+	// the records of the chunk being built and how many there are; the chunk's own header is added when it's written
+	CDataBuffer m_Body;
+	size_t m_Count;
+
+	CCompactWriter m_Compact;
+
+	// aligned records are placed as though the chunk's header came before them
+	CAlignedWriter m_Aligned;
+
+public:
+	enum
+	{
+		MAX_CHUNK_PROPS = 32767,
+		MAX_CHUNK_BYTES = (64 << 20)
+	};
 
-	for (TPropertyMap::const_iterator it = m_mapProps.begin(), last_it = m_mapProps.end(); it != last_it; it++)
+	// a chunk can run one property past chunksize, so that's kept to half the limit
+	static size_t CapChunkSize(size_t chunksize)
 	{
-		size_t pused = 0;
-		CProperty *p = (CProperty *)(it->second);
-		p->Serialize(mode, nullptr, 0, &pused);
-		used += pused;
+		return ::std::min<size_t>(chunksize, MAX_CHUNK_BYTES / 2);
 	}
 
-	if (amountused)
-		*amountused = used;
+	CChunkWriter(IProperty::SERIALIZE_MODE mode, IDataSink *psink, size_t chunksize, size_t count) : m_Body(CapChunkSize(chunksize) + (CapChunkSize(chunksize) / 4)), m_Compact(&m_Body), m_Aligned(&m_Body, CAlignedWriter::HEADER_SIZE)
+	{
+		m_pSink = psink;
+		m_Mode = mode;
+		m_ChunkSize = CapChunkSize(chunksize);
+		m_Count = 0;
+
+		short marker = -2;
+		uint32_t total = uint32_t(count);
+		m_OK = psink && psink->Write(&marker, sizeof(short)) && psink->Write(&total, sizeof(uint32_t));
+	}
 
-	if (used > bufsize)
-		return false;
+	bool Add(CProperty *pprop)
+	{
+		if (!m_OK)
+			return false;
 
-	*((short *)buf) = short(m_mapProps.size());
-	bufsize -= sizeof(short);
-	buf += sizeof(short);
+		if (m_Mode == IProperty::SM_BIN_COMPACT)
+			pprop->SerializeCompact(m_Compact);
+		else if (m_Mode == IProperty::SM_BIN_ALIGNED)
+			pprop->SerializeAligned(m_Aligned);
+		else if (!pprop->Serialize(m_Mode, &m_Body))
+			return (m_OK = false);
+
+		m_Count++;
+
+		if ((m_Count == MAX_CHUNK_PROPS) || (m_Body.GetSize() >= m_ChunkSize))
+			return Flush();
+
+		return true;
+	}
+
+	bool Flush()
+	{
+		if (!m_OK || !m_Count)
+			return m_OK;
+
+		CDataBuffer hdr(16);
+		if (m_Mode == IProperty::SM_BIN_COMPACT)
+		{
+			m_OK = m_Compact.EndSet();
+			m_Compact.Restart();
+
+			CCompactWriter w(&hdr);
+			w.BeginSet(m_Count);
+			w.Flush();
+		}
+		else if (m_Mode == IProperty::SM_BIN_ALIGNED)
+		{
+			m_OK = m_Aligned.OK();
+			m_Aligned.Restart(CAlignedWriter::HEADER_SIZE);
+
+			CAlignedWriter w(&hdr);
+			w.BeginSet(m_Count);
+		}
+		else
+		{
+			short numprops = short(m_Count);
+			hdr.Write(&numprops, sizeof(short));
+		}
+
+		size_t total = hdr.GetSize() + m_Body.GetSize();
+		uint32_t sz = uint32_t(total);
+		m_OK = m_OK && (total <= MAX_CHUNK_BYTES) && m_pSink->Write(&sz, sizeof(uint32_t)) && m_pSink->Write(hdr.GetData(), hdr.GetSize()) && m_pSink->Write(m_Body.GetData(), m_Body.GetSize());
+
+		m_Body.Reset();
+		m_Count = 0;
+
+		return m_OK;
+	}
+
+	bool End()
+	{
+		uint32_t sz = 0;
+		return Flush() && m_pSink->Write(&sz, sizeof(uint32_t));
+	}
+
+	// the number of properties in a chunk, read from its header
+	static bool ChunkCount(const BYTE *buf, size_t bufsize, size_t *count)
+	{
+		if (CCompactReader::IsCompact(buf, bufsize))
+		{
+			CCompactReader r(buf, bufsize);
+			return r.BeginSet(count);
+		}
+
+		if (CAlignedReader::IsAlignedSet(buf, bufsize))
+		{
+			CAlignedReader r(buf, bufsize);
+			return r.BeginSet(count);
+		}
+
+		short numprops;
+		if (bufsize < sizeof(short))
+			return false;
+
+		memcpy(&numprops, buf, sizeof(short));
+		*count = size_t(numprops);
+
+		return (numprops >= 0);
+	}
+};
+
+
+// archives are an SArchiveHeader, then an SArchiveEntry for every property, sorted by id, then the properties, each one
+// serialized with SM_BIN_VERBOSE; entry offsets are from the start of the archive
+#define ARCHIVE_MAGIC		'PPAR'
+#define ARCHIVE_VERSION		1
 
-	for (TPropertyMap::const_iterator it = m_mapProps.begin(), last_it = m_mapProps.end(); it != last_it; it++)
+struct SArchiveHeader
+{
+	uint32_t m_Magic;
+	uint16_t m_Version;
+	uint16_t m_EntrySize;
+	uint32_t m_Count;
+	uint32_t m_Reserved;
+};
+
+struct SArchiveEntry
+{
+	FOURCHARCODE m_ID;
+	uint8_t m_Type;
+	uint8_t m_Aspect;
+	uint16_t m_Reserved;
+	uint32_t m_Offset;
+	uint32_t m_Size;
+};
+
+class CArchiveWriter
+{
+protected:
+	::std::vector<SArchiveEntry> m_Index;
+	CDataBuffer m_Body;
+	bool m_OK;
+
+public:
+	CArchiveWriter(size_t count) : m_Body(0)
+	{
+		m_Index.reserve(count);
+		m_OK = true;
+	}
+
+	void Add(CProperty *pprop)
+	{
+		SArchiveEntry e;
+		e.m_ID = pprop->GetID();
+		e.m_Type = uint8_t(pprop->GetType());
+		e.m_Aspect = uint8_t(pprop->GetAspect());
+		e.m_Reserved = 0;
+		e.m_Offset = uint32_t(m_Body.GetSize());
+
+		m_OK = m_OK && pprop->Serialize(IProperty::SM_BIN_VERBOSE, &m_Body);
+
+		e.m_Size = uint32_t(m_Body.GetSize() - e.m_Offset);
+		m_Index.push_back(e);
+	}
+
+	bool End(IDataSink *psink)
+	{
+		size_t hdrsize = sizeof(SArchiveHeader) + (m_Index.size() * sizeof(SArchiveEntry));
+		if (!m_OK || !psink || ((hdrsize + m_Body.GetSize()) > UINT32_MAX))
+			return false;
+
+		::std::sort(m_Index.begin(), m_Index.end(), [](const SArchiveEntry &a, const SArchiveEntry &b) { return a.m_ID < b.m_ID; });
+
+		for (SArchiveEntry &e : m_Index)
+			e.m_Offset += uint32_t(hdrsize);
+
+		SArchiveHeader hdr;
+		hdr.m_Magic = ARCHIVE_MAGIC;
+		hdr.m_Version = ARCHIVE_VERSION;
+		hdr.m_EntrySize = sizeof(SArchiveEntry);
+		hdr.m_Count = uint32_t(m_Index.size());
+		hdr.m_Reserved = 0;
+
+		return psink->Write(&hdr, sizeof(SArchiveHeader)) && psink->Write(m_Index.data(), m_Index.size() * sizeof(SArchiveEntry)) &&
+			psink->Write(m_Body.GetData(), m_Body.GetSize());
+	}
+};
+
+
+bool CPropertySet::SerializeArchive(IDataSink *psink) const
+{
+	CArchiveWriter w(m_Props.size());
+
+	for (TPropertyArray::const_iterator it = m_Props.cbegin(), last_it = m_Props.cend(); it != last_it; it++)
+		w.Add((CProperty *)(*it));
+
+	return w.End(psink);
+}
+
+bool CPropertySet::SerializeChunked(IProperty::SERIALIZE_MODE mode, IDataSink *psink, size_t chunksize) const
+{
+	CChunkWriter w(mode, psink, chunksize, m_Props.size());
+
+	for (TPropertyArray::const_iterator it = m_Props.cbegin(), last_it = m_Props.cend(); it != last_it; it++)
 	{
-		size_t pused = 0;
-		CProperty *p = (CProperty *)(it->second);
-		if (!p->Serialize(mode, buf, bufsize, &pused))
+		if (!w.Add((CProperty *)(*it)))
 			return false;
+	}
+
+	return w.End();
+}
+
+bool CPropertySet::Serialize(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
+{
+	return SerializeProperties(0, mode, psink);
+}
+
+// every property's stamp is at least 1, so a checkpoint of 0 writes them all
+bool CPropertySet::SerializeProperties(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
+{
+	if (!psink)
+		return false;
+
+	size_t count = checkpoint ? 0 : m_Props.size();
+	for (TPropertyArray::const_iterator it = m_Props.cbegin(), last_it = m_Props.cend(); checkpoint && (it != last_it); it++)
+	{
+		if (((CProperty *)(*it))->m_Stamp > checkpoint)
+			count++;
+	}
+
+	if (mode == IProperty::SM_BIN_COMPACT)
+	{
+		CCompactWriter w(psink);
+		w.BeginSet(count);
+
+		for (TPropertyArray::const_iterator it = m_Props.cbegin(), last_it = m_Props.cend(); it != last_it; it++)
+		{
+			CProperty *p = (CProperty *)(*it);
+			if (p->m_Stamp > checkpoint)
+				p->SerializeCompact(w);
+		}
+
+		return w.EndSet();
+	}
+
+	if (mode == IProperty::SM_BIN_ALIGNED)
+	{
+		CAlignedWriter w(psink);
+		w.BeginSet(count);
+
+		for (TPropertyArray::const_iterator it = m_Props.cbegin(), last_it = m_Props.cend(); it != last_it; it++)
+		{
+			CProperty *p = (CProperty *)(*it);
+			if (p->m_Stamp > checkpoint)
+				p->SerializeAligned(w);
+		}
+
+		return w.OK();
+	}
+
+	// the other modes' count is a short, whose negative values mark the other kinds of set
+	if (count > SHRT_MAX)
+		return false;
 
-		buf += pused;
-		bufsize -= pused;
+	short numprops = short(count);
+	if (!psink->Write(&numprops, sizeof(short)))
+		return false;
+
+	for (TPropertyArray::const_iterator it = m_Props.cbegin(), last_it = m_Props.cend(); it != last_it; it++)
+	{
+		CProperty *p = (CProperty *)(*it);
+		if ((p->m_Stamp > checkpoint) && !p->Serialize(mode, psink))
+			return false;
 	}
 
 	return true;
@@ -2828,6 +3729,12 @@ bool CPropertySet::Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
 	if (!buf)
 		return false;
 
+	if (CCompactReader::IsCompact(buf, bufsize))
+		return DeserializeCompact(buf, bufsize, bytesconsumed);
+
+	if (CAlignedReader::IsAlignedSet(buf, bufsize))
+		return DeserializeAligned(buf, bufsize, bytesconsumed);
+
 	short numprops = *((short *)buf);
 	buf += sizeof(short);
 	bufsize -= sizeof(short);
@@ -2844,7 +3751,7 @@ bool CPropertySet::Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
 		CProperty *p = (CProperty *)GetPropertyById(id);
 		if (!p)
 		{
-			p = new CProperty(this);
+			p = NewProperty();
 			if (p)
 			{
 				p->SetID(id);
@@ -2856,6 +3763,8 @@ bool CPropertySet::Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
 		if (!p || !p->Deserialize(buf, bufsize, &bc))
 			return false;
 
+		p->Touch();
+
 		consumed += bc;
 
 		buf += bc;
@@ -2872,465 +3781,3860 @@ bool CPropertySet::Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
 }
 
 
-void CPropertySet::SetChangeListener(const IPropertyChangeListener *plistener)
+uint64_t CPropertySet::GetCheckpoint() const
 {
-	m_pListener = (IPropertyChangeListener *)plistener;
+	// deltas are only wanted once someone holds a checkpoint, so deletions aren't logged until then
+	m_TrackDeletions = true;
+
+	return m_Stamp;
 }
 
-namespace props
+
+bool CPropertySet::SerializeDelta(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
 {
+	if (!psink)
+		return false;
 
-void UnescapeString(const TCHAR *in, tstring &out)
+	::std::vector<FOURCHARCODE> deleted;
+	for (TDeletionLog::const_iterator it = m_Deletions.cbegin(), last_it = m_Deletions.cend(); it != last_it; it++)
+	{
+		if (it->second > checkpoint)
+			deleted.push_back(it->first);
+	}
+
+	if (!WriteDeltaHeader(psink, (m_ClearStamp > checkpoint), deleted.data(), deleted.size()))
+		return false;
+
+	return SerializeProperties(checkpoint, mode, psink);
+}
+
+
+void CPropertySet::TrimDeltaHistory(uint64_t checkpoint)
 {
-	out.clear();
-	out.reserve(_tcslen(in));
-	const TCHAR *c = in;
-	while (c && *c)
+	for (TDeletionLog::iterator it = m_Deletions.begin(); it != m_Deletions.end(); )
 	{
-		if (*c == _T('&'))
-		{
-			if (!memcmp(c, _T("&lt;"), sizeof(TCHAR) * 4))
-			{
-				out += _T('<');
-				c += 3;
-			}
-			else if (!memcmp(c, _T("&gt;"), sizeof(TCHAR) * 4))
-			{
-				out += _T('>');
-				c += 3;
-			}
-			else if (!memcmp(c, _T("&amp;"), sizeof(TCHAR) * 5))
-			{
-				out += _T('&');
-				c += 4;
-			}
-			else if (!memcmp(c, _T("&quot;"), sizeof(TCHAR) * 6))
-			{
-				out += _T('\"');
-				c += 5;
-			}
-		}
+		if (it->second <= checkpoint)
+			it = m_Deletions.erase(it);
 		else
-			out += *c;
-
-		c++;
+			it++;
 	}
 }
 
-void EscapeString(const TCHAR *in, tstring &out)
+
+bool CPropertySetBase::WriteDeltaHeader(IDataSink *psink, bool clear, const FOURCHARCODE *deleted, size_t numdeleted)
 {
-	out.clear();
-	out.reserve(_tcslen(in) * 2);
-	const TCHAR *c = in;
-	while (c && *c)
-	{
-		switch (*c)
-		{
-			case _T('<'):
-			{
-				out += _T("&lt;");
-				break;
-			}
-			case _T('>'):
-			{
-				out += _T("&gt;");
-				break;
-			}
-			case _T('&'):
-			{
-				out += _T("&amp;");
-				break;
-			}
-			case _T('\"'):
-			{
-				out += _T("&quot;");
-				break;
-			}
-			default:
-			{
-				out += *c;
-				break;
-			}
-		};
+	BYTE flags = clear ? DELTA_CLEAR : 0;
+	if (!psink->Write(&flags, sizeof(BYTE)))
+		return false;
 
-		c++;
-	}
+	if (numdeleted > UINT32_MAX)
+		return false;
+
+	uint32_t n = uint32_t(numdeleted);
+	if (!psink->Write(&n, sizeof(uint32_t)))
+		return false;
+
+	return (!numdeleted || psink->Write(deleted, sizeof(FOURCHARCODE) * numdeleted));
 }
 
-};
 
-bool CPropertySet::SerializeToXMLString(IProperty::SERIALIZE_MODE mode, tstring &xmls) const
+bool CPropertySetBase::ApplyDelta(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
 {
-	xmls.clear();
+	if (!buf || (bufsize < (sizeof(BYTE) + sizeof(uint32_t))))
+		return false;
 
-	// reserve 16K for the string
-	xmls.reserve(1 << 14);
+	BYTE flags = *buf;
+	buf += sizeof(BYTE);
 
-	xmls += _T("<powerprops:property_set>\n");
+	uint32_t numdeleted;
+	memcpy(&numdeleted, buf, sizeof(uint32_t));
+	buf += sizeof(uint32_t);
+
+	if (numdeleted > ((bufsize - sizeof(BYTE) - sizeof(uint32_t)) / sizeof(FOURCHARCODE)))
+		return false;
+
+	size_t hdrsize = sizeof(BYTE) + sizeof(uint32_t) + (sizeof(FOURCHARCODE) * numdeleted);
 
-	for (TPropertyMap::const_iterator it = m_mapProps.cbegin(); it != m_mapProps.cend(); it++)
+	if (flags & DELTA_CLEAR)
+		DeleteAll();
+
+	for (uint32_t i = 0; i < numdeleted; i++)
 	{
-		if (!it->second)
-			continue;
+		DeletePropertyById(*((FOURCHARCODE *)buf));
+		buf += sizeof(FOURCHARCODE);
+	}
 
-		xmls += _T("<powerprops:property ");
+	// what follows is exactly what Serialize writes
+	size_t bc = 0;
+	if (!Deserialize(buf, bufsize - hdrsize, &bc))
+		return false;
 
-		xmls += _T("id=\"");
-		FOURCHARCODE id = it->second->GetID();
-		uint8_t *pid = (uint8_t *)&id;
+	if (bytesconsumed)
+		*bytesconsumed = hdrsize + bc;
 
-		tstring idtemp;
-		for (size_t i = 0; i < 4; i++)
+	return true;
+}
+
+
+bool CPropertySet::DeserializeCompact(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
+{
+	CCompactReader r(buf, bufsize);
+
+	size_t numprops;
+	if (!r.BeginSet(&numprops))
+		return false;
+
+	// booleans get their values from the bit array after the records
+	::std::vector<CProperty *> bools;
+
+	for (size_t i = 0; i < numprops; i++)
+	{
+		FOURCHARCODE id;
+		if (!r.ReadRaw(&id, sizeof(FOURCHARCODE)))
+			return false;
+
+		CProperty *p = (CProperty *)GetPropertyById(id);
+		if (!p)
 		{
-			TCHAR c = pid[3 - i];
+			p = NewProperty();
+			if (!p)
+				return false;
+
+			p->SetID(id);
+			AddProperty(p);
+		}
+
+		if (!p->DeserializeCompact(r))
+			return false;
+
+		p->Touch();
+
+		if (p->m_Type == IProperty::PT_BOOLEAN)
+			bools.push_back(p);
+	}
+
+	if (!r.BeginBools(bools.size()))
+		return false;
+
+	for (size_t i = 0, maxi = bools.size(); i < maxi; i++)
+		bools[i]->StoreBool(r.ReadBool(i));
+
+	if (bytesconsumed)
+		*bytesconsumed = r.GetConsumed();
+
+	return true;
+}
+
+
+bool CPropertySet::DeserializeAligned(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
+{
+	CAlignedReader r(buf, bufsize);
+
+	size_t numprops;
+	if (!r.BeginSet(&numprops))
+		return false;
+
+	for (size_t i = 0; i < numprops; i++)
+	{
+		FOURCHARCODE id;
+		if (!r.ReadAligned(&id, sizeof(FOURCHARCODE), sizeof(FOURCHARCODE)))
+			return false;
+
+		CProperty *p = (CProperty *)GetPropertyById(id);
+		if (!p)
+		{
+			p = NewProperty();
+			if (!p)
+				return false;
+
+			p->SetID(id);
+			AddProperty(p);
+		}
+
+		if (!p->DeserializeAligned(r))
+			return false;
+
+		p->Touch();
+	}
+
+	if (bytesconsumed)
+		*bytesconsumed = r.GetConsumed();
+
+	return true;
+}
+
+
+// compressed sets are a short of -6, the codec's id, then 64-bit sizes of the set before and after compression, and then
+// the compressed set
+bool CPropertySetBase::SerializeCompressed(IProperty::SERIALIZE_MODE mode, IPropertyCodec *pcodec, IDataSink *psink) const
+{
+	if (!psink)
+		return false;
+
+	if (!pcodec)
+		pcodec = CLZCodec::Get();
+
+	CDataBuffer raw(0), packed(0);
+	if (!Serialize(mode, &raw) || !pcodec->Compress(raw.GetData(), raw.GetSize(), &packed))
+		return false;
+
+	short marker = -6;
+	uint32_t codec = pcodec->GetID();
+	uint64_t rawsize = raw.GetSize(), packedsize = packed.GetSize();
+
+	return psink->Write(&marker, sizeof(short)) && psink->Write(&codec, sizeof(uint32_t)) && psink->Write(&rawsize, sizeof(uint64_t)) &&
+		psink->Write(&packedsize, sizeof(uint64_t)) && psink->Write(packed.GetData(), packed.GetSize());
+}
+
+bool CPropertySetBase::DeserializeCompressed(const uint8_t *buf, size_t bufsize, IPropertyCodec *pcodec, size_t *bytesconsumed)
+{
+	const size_t hdrsize = sizeof(short) + sizeof(uint32_t) + (sizeof(uint64_t) * 2);
+	if (!buf || (bufsize < hdrsize))
+		return false;
+
+	if (!pcodec)
+		pcodec = CLZCodec::Get();
+
+	short marker;
+	uint32_t codec;
+	uint64_t rawsize, packedsize;
+	memcpy(&marker, buf, sizeof(short));
+	memcpy(&codec, buf + sizeof(short), sizeof(uint32_t));
+	memcpy(&rawsize, buf + sizeof(short) + sizeof(uint32_t), sizeof(uint64_t));
+	memcpy(&packedsize, buf + sizeof(short) + sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint64_t));
+
+	if ((marker != -6) || (codec != pcodec->GetID()) || (packedsize > (bufsize - hdrsize)) || (rawsize > SIZE_MAX))
+		return false;
+
+	// the raw size comes from the data, so it has to be one the codec could have produced from the packed size
+	// before anything is allocated for it
+	size_t ratio = pcodec->GetMaxRatio();
+	if (!ratio || ((rawsize / ratio) > packedsize))
+		return false;
+
+	BYTE *raw = (BYTE *)malloc(rawsize ? size_t(rawsize) : 1);
+	if (!raw)
+		return false;
+
+	size_t used = 0;
+	bool ok = pcodec->Decompress(buf + hdrsize, size_t(packedsize), raw, size_t(rawsize)) && Deserialize(raw, size_t(rawsize), &used) && (used == size_t(rawsize));
+
+	free(raw);
+
+	if (!ok)
+		return false;
+
+	if (bytesconsumed)
+		*bytesconsumed = hdrsize + size_t(packedsize);
+
+	return true;
+}
+
+
+bool CPropertySetBase::DeserializeChunked(IDataSource *psource)
+{
+	if (!psource)
+		return false;
+
+	// fills buf completely or fails
+	auto ReadAll = [psource](void *buf, size_t size) -> bool
+	{
+		for (size_t got = 0; got < size; )
+		{
+			size_t n = psource->Read((BYTE *)buf + got, size - got);
+			if (!n)
+				return false;
+
+			got += n;
+		}
+
+		return true;
+	};
+
+	short marker;
+	uint32_t total;
+	if (!ReadAll(&marker, sizeof(short)) || (marker != -2) || !ReadAll(&total, sizeof(uint32_t)))
+		return false;
+
+	// reused for every chunk, so it only ever grows to the size of the largest one
+	::std::vector<BYTE> chunk;
+	size_t numread = 0;
+
+	for (;;)
+	{
+		uint32_t sz;
+		if (!ReadAll(&sz, sizeof(uint32_t)))
+			return false;
+
+		if (!sz)
+			break;
+
+		// the size hasn't been checked against anything else yet, so it's held to what a writer can produce
+		if (sz > CChunkWriter::MAX_CHUNK_BYTES)
+			return false;
+
+		chunk.resize(sz);
+		if (!ReadAll(chunk.data(), sz))
+			return false;
+
+		size_t count = 0, used = 0;
+		if (!CChunkWriter::ChunkCount(chunk.data(), sz, &count) || !Deserialize(chunk.data(), sz, &used) || (used != sz))
+			return false;
+
+		numread += count;
+	}
+
+	return (numread == total);
+}
+
+
+void CPropertySetBase::SetChangeListener(const IPropertyChangeListener *plistener)
+{
+	m_pListener = (IPropertyChangeListener *)plistener;
+}
+
+namespace props
+{
+
+void UnescapeString(const TCHAR *in, tstring &out)
+{
+	out.clear();
+	out.reserve(_tcslen(in));
+	const TCHAR *c = in;
+	while (c && *c)
+	{
+		if (*c == _T('&'))
+		{
+			if (!memcmp(c, _T("&lt;"), sizeof(TCHAR) * 4))
+			{
+				out += _T('<');
+				c += 3;
+			}
+			else if (!memcmp(c, _T("&gt;"), sizeof(TCHAR) * 4))
+			{
+				out += _T('>');
+				c += 3;
+			}
+			else if (!memcmp(c, _T("&amp;"), sizeof(TCHAR) * 5))
+			{
+				out += _T('&');
+				c += 4;
+			}
+			else if (!memcmp(c, _T("&quot;"), sizeof(TCHAR) * 6))
+			{
+				out += _T('\"');
+				c += 5;
+			}
+		}
+		else
+			out += *c;
+
+		c++;
+	}
+}
+
+void EscapeString(const TCHAR *in, tstring &out)
+{
+	out.clear();
+	out.reserve(_tcslen(in) * 2);
+	const TCHAR *c = in;
+	while (c && *c)
+	{
+		switch (*c)
+		{
+			case _T('<'):
+			{
+				out += _T("&lt;");
+				break;
+			}
+			case _T('>'):
+			{
+				out += _T("&gt;");
+				break;
+			}
+			case _T('&'):
+			{
+				out += _T("&amp;");
+				break;
+			}
+			case _T('\"'):
+			{
+				out += _T("&quot;");
+				break;
+			}
+			default:
+			{
+				out += *c;
+				break;
+			}
+		};
+
+		c++;
+	}
+}
+
+};
+
+// every kind of set writes through a sink; this adapts the caller's buffer to one, measuring and writing in the same pass
+bool CPropertySetBase::Serialize(IProperty::SERIALIZE_MODE mode, BYTE *buf, size_t bufsize, size_t *amountused) const
+{
+	CFixedDataSink sink(buf, bufsize);
+	bool ret = Serialize(mode, &sink);
+
+	if (amountused)
+		*amountused = sink.GetSize();
+
+	return (ret && sink.Fits());
+}
+
+// the names the text formats give each PROPERTY_TYPE, in order; an unset property is written as a string
+static const TCHAR *s_TypeNames[props::IProperty::PROPERTY_TYPE::PT_NUMTYPES] =
+{
+	_T("STRING"),
+	_T("STRING"),
+	_T("INT"),
+	_T("INT_V2"),
+	_T("INT_V3"),
+	_T("INT_V4"),
+	_T("FLOAT"),
+	_T("FLOAT_V2"),
+	_T("FLOAT_V3"),
+	_T("FLOAT_V4"),
+	_T("GUID"),
+	_T("ENUM"),
+	_T("BOOLEAN"),
+	_T("FLOAT_MAT3X3"),
+	_T("FLOAT_MAT4X4")
+};
+
+static const TCHAR *TypeName(props::IProperty::PROPERTY_TYPE type)
+{
+	return s_TypeNames[(type < props::IProperty::PROPERTY_TYPE::PT_NUMTYPES) ? type : props::IProperty::PROPERTY_TYPE::PT_STRING];
+}
+
+// a missing or unknown type is a string
+static props::IProperty::PROPERTY_TYPE TypeFromName(const STextSpan &name)
+{
+	for (size_t i = props::IProperty::PROPERTY_TYPE::PT_STRING; i < props::IProperty::PROPERTY_TYPE::PT_NUMTYPES; i++)
+	{
+		if (name.Is(s_TypeNames[i]))
+			return (props::IProperty::PROPERTY_TYPE)i;
+	}
+
+	return props::IProperty::PROPERTY_TYPE::PT_STRING;
+}
+
+// the aspects that are written by name; any others are written as numbers
+static const struct
+{
+	props::IProperty::PROPERTY_ASPECT aspect;
+	const TCHAR *name;
+} s_AspectNames[] =
+{
+	{props::IProperty::PROPERTY_ASPECT::PA_BOOL_ONOFF, _T("BOOL_ONOFF")},
+	{props::IProperty::PROPERTY_ASPECT::PA_BOOL_YESNO, _T("BOOL_YESNO")},
+	{props::IProperty::PROPERTY_ASPECT::PA_COLOR_RGB, _T("COLOR_RGB")},
+	{props::IProperty::PROPERTY_ASPECT::PA_COLOR_RGBA, _T("COLOR_RGBA")},
+	{props::IProperty::PROPERTY_ASPECT::PA_DATE, _T("DATE")},
+	{props::IProperty::PROPERTY_ASPECT::PA_DIRECTORY, _T("DIRECTORY")},
+	{props::IProperty::PROPERTY_ASPECT::PA_ELEVAZIM, _T("ELEVAZIM")},
+	{props::IProperty::PROPERTY_ASPECT::PA_FILENAME, _T("FILENAME")},
+	{props::IProperty::PROPERTY_ASPECT::PA_FONT_DESC, _T("FONT_DESC")},
+	{props::IProperty::PROPERTY_ASPECT::PA_IPADDRESS, _T("IP_ADDRESS")},
+	{props::IProperty::PROPERTY_ASPECT::PA_LATLON, _T("LATLON")},
+	{props::IProperty::PROPERTY_ASPECT::PA_QUATERNION, _T("QUATERNION")},
+	{props::IProperty::PROPERTY_ASPECT::PA_RASCDEC, _T("RASCDEC")},
+	{props::IProperty::PROPERTY_ASPECT::PA_TIME, _T("TIME")}
+};
+
+// returns the aspect's name, or formats its number into buf
+static const TCHAR *AspectName(props::IProperty::PROPERTY_ASPECT aspect, TCHAR *buf, size_t bufsize)
+{
+	for (size_t i = 0; i < _countof(s_AspectNames); i++)
+	{
+		if (s_AspectNames[i].aspect == aspect)
+			return s_AspectNames[i].name;
+	}
+
+	_itot_s((int)aspect, buf, bufsize, 10);
+	return buf;
+}
+
+static props::IProperty::PROPERTY_ASPECT AspectFromName(const STextSpan &name)
+{
+	for (size_t i = 0; i < _countof(s_AspectNames); i++)
+	{
+		if (name.Is(s_AspectNames[i].name))
+			return s_AspectNames[i].aspect;
+	}
+
+	int64_t a;
+	CValueParser::ParseInts(name, &a, 1);
+	return (props::IProperty::PROPERTY_ASPECT)a;
+}
+
+// gathers text into a fixed-size buffer and hands it to a sink each time it fills
+class CTextWriter
+{
+protected:
+	IDataSink *m_pSink;
+	bool m_OK;
+
+	TCHAR m_Buf[1 << 12];
+	size_t m_Used;
+
+public:
+	CTextWriter(IDataSink *psink)
+	{
+		m_pSink = psink;
+		m_OK = (psink != nullptr);
+		m_Used = 0;
+	}
+
+	~CTextWriter()
+	{
+		Flush();
+	}
+
+	bool Flush()
+	{
+		if (m_Used && m_OK)
+			m_OK = m_pSink->Write(m_Buf, m_Used * sizeof(TCHAR));
+
+		m_Used = 0;
+
+		return m_OK;
+	}
+
+	void Append(const TCHAR *s, size_t len)
+	{
+		while (len)
+		{
+			if (m_Used == _countof(m_Buf))
+				Flush();
+
+			size_t n = ::std::min(len, _countof(m_Buf) - m_Used);
+			memcpy(m_Buf + m_Used, s, n * sizeof(TCHAR));
+
+			m_Used += n;
+			s += n;
+			len -= n;
+		}
+	}
+
+	CTextWriter &operator +=(const TCHAR *s)
+	{
+		Append(s, _tcslen(s));
+		return *this;
+	}
+
+	CTextWriter &operator +=(const tstring &s)
+	{
+		Append(s.c_str(), s.length());
+		return *this;
+	}
+
+	CTextWriter &operator +=(TCHAR c)
+	{
+		Append(&c, 1);
+		return *this;
+	}
+};
+
+
+bool CPropertySetBase::SerializeToXMLString(IProperty::SERIALIZE_MODE mode, tstring &xmls) const
+{
+	xmls.clear();
+
+	// reserve 16K for the string
+	xmls.reserve(1 << 14);
+
+	CStringDataSink sink(xmls);
+	return SerializeToXML(mode, &sink);
+}
+
+bool CPropertySetBase::SerializeToXML(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
+{
+	if (!psink)
+		return false;
+
+	CTextWriter xmls(psink);
+
+	// reused for every property
+	tstring text, esc;
+
+	xmls += _T("<powerprops:property_set>\n");
+
+	for (size_t propidx = 0, maxidx = GetPropertyCount(); propidx < maxidx; propidx++)
+	{
+		IProperty *pprop = GetProperty(propidx);
+		if (!pprop)
+			continue;
+
+		xmls += _T("<powerprops:property ");
+
+		xmls += _T("id=\"");
+		FOURCHARCODE id = pprop->GetID();
+		uint8_t *pid = (uint8_t *)&id;
+
+		tstring idtemp;
+		for (size_t i = 0; i < 4; i++)
+		{
+			TCHAR c = pid[3 - i];
+			if (c)
+			{
+				if (isalnum(c))
+				{
+					idtemp += c;
+				}
+				else
+				{
+					idtemp += _T("&#");
+					TCHAR num[8];
+					_itot_s(c, num, 10);
+					idtemp += num;
+					idtemp += _T(";");
+				}
+			}
+		}
+		xmls += idtemp;
+		xmls += _T("\"");
+
+		if (mode == props::IProperty::SERIALIZE_MODE::SM_BIN_VERBOSE)
+		{
+			xmls += _T(" name=\"");
+			props::EscapeString(pprop->GetName(), esc);
+			xmls += esc;
+			xmls += _T("\"");
+		}
+
+		xmls += _T(" type=\"");
+		xmls += TypeName(pprop->GetType());
+		xmls += _T("\"");
+
+		if ((mode >= props::IProperty::SERIALIZE_MODE::SM_BIN_TERSE) && (pprop->GetAspect() != props::IProperty::PROPERTY_ASPECT::PA_GENERIC))
+		{
+			xmls += _T(" aspect=\"");
+			TCHAR t[16];
+			xmls += AspectName(pprop->GetAspect(), t, _countof(t));
+			xmls += _T("\"");
+		}
+
+		xmls += _T(">");
+
+		// only strings and enums can hold characters that need escaping
+		switch (pprop->GetType())
+		{
+			case props::IProperty::PROPERTY_TYPE::PT_STRING:
+			{
+				const TCHAR *str = pprop->AsString();
+				props::EscapeString(str ? str : _T(""), esc);
+				xmls += esc;
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_ENUM:
+			{
+				text.clear();
+
+				TCHAR q[1 << 12];
+				for (size_t i = 0; i < pprop->GetMaxEnumVal(); i++)
+				{
+					if (i)
+						text += _T(',');
+
+					q[0] = _T('\0');
+					pprop->GetEnumString(i, q, _countof(q));
+					text += q;
+				}
+
+				TCHAR num[CValueFormatter::MAX_NUMBER_CHARS + 1];
+				num[0] = _T(':');
+				text.append(num, CValueFormatter::Format(pprop->AsInt(), num + 1) + 1);
+
+				props::EscapeString(text.c_str(), esc);
+				xmls += esc;
+				break;
+			}
+
+			default:
+			{
+				TCHAR v[CValueFormatter::MAX_VALUE_CHARS];
+				xmls += pprop->AsString(v, _countof(v));
+				break;
+			}
+		}
+
+		xmls += _T("</powerprops:property>\n");
+	}
+
+	xmls += _T("</powerprops:property_set>");
+
+	return xmls.Flush();
+}
+
+// sets a number, vector, matrix or GUID value from its text; false for the types that need more than that.
+// wellformed says whether the text was exactly such a value; if not, whatever couldn't be read is set to 0
+static bool SetValueFromText(props::IProperty *pp, props::IProperty::PROPERTY_TYPE type, const STextSpan &text, bool *wellformed)
+{
+	bool ok;
+
+	switch (type)
+	{
+		case props::IProperty::PROPERTY_TYPE::PT_INT:
+		{
+			int64_t i;
+			ok = CValueParser::ParseInts(text, &i, 1);
+			pp->SetInt(i);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_INT_V2:
+		{
+			props::TVec2I iv;
+			ok = CValueParser::ParseInts(text, iv.v, 2);
+			pp->SetVec2I(iv);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_INT_V3:
+		{
+			props::TVec3I iv;
+			ok = CValueParser::ParseInts(text, iv.v, 3);
+			pp->SetVec3I(iv);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_INT_V4:
+		{
+			props::TVec4I iv;
+			ok = CValueParser::ParseInts(text, iv.v, 4);
+			pp->SetVec4I(iv);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_FLOAT:
+		{
+			float f;
+			ok = CValueParser::ParseFloats(text, &f, 1);
+			pp->SetFloat(f);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V2:
+		{
+			props::TVec2F fv;
+			ok = CValueParser::ParseFloats(text, fv.v, 2);
+			pp->SetVec2F(fv);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V3:
+		{
+			props::TVec3F fv;
+			ok = CValueParser::ParseFloats(text, fv.v, 3);
+			pp->SetVec3F(fv);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V4:
+		{
+			props::TVec4F fv;
+			ok = CValueParser::ParseFloats(text, fv.v, 4);
+			pp->SetVec4F(fv);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_FLOAT_MAT3X3:
+		{
+			props::TMat3x3F m;
+			ok = CValueParser::ParseMatrix(text, m);
+			pp->SetMat3x3F(&m);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_FLOAT_MAT4X4:
+		{
+			props::TMat4x4F m;
+			ok = CValueParser::ParseMatrix(text, m);
+			pp->SetMat4x4F(&m);
+			break;
+		}
+
+		case props::IProperty::PROPERTY_TYPE::PT_GUID:
+		{
+			GUID g;
+			ok = CValueParser::ParseGUID(text, g);
+			pp->SetGUID(g);
+			break;
+		}
+
+		default:
+			return false;
+	}
+
+	if (wellformed)
+		*wellformed = ok;
+
+	return true;
+}
+
+bool CPropertySetBase::DeserializeFromXMLString(const tstring &xmls)
+{
+	CXMLReader reader(xmls.c_str(), xmls.length());
+	CXMLReader::SProperty xp;
+	CXMLReader::RESULT r;
+
+	// reused for every property, so they stop allocating once they've grown to fit
+	tstring propname, v;
+
+	while ((r = reader.Next(xp)) == CXMLReader::R_PROPERTY)
+	{
+		FOURCHARCODE fcc;
+		if (!CXMLReader::DecodeID(xp.id, v, fcc))
+			return false;
+
+		CXMLReader::Unescape(xp.name, propname);
+
+		props::IProperty *pp = GetPropertyById(fcc);
+
+		if (!pp && !propname.empty())
+			pp = GetPropertyByName(propname.c_str());
+
+		if (!pp)
+			pp = CreateProperty(propname.c_str(), fcc);
+
+		if (!pp)
+			return false;
+
+		// parse the text directly into the declared type; only strings and enums need it copied out
+		props::IProperty::PROPERTY_TYPE type = TypeFromName(xp.type);
+		switch (type)
+		{
+			case props::IProperty::PROPERTY_TYPE::PT_BOOLEAN:
+			{
+				bool b;
+				CValueParser::ParseBool(xp.value, b);
+				pp->SetBool(b);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_ENUM:
+			{
+				// the enum's strings, then a colon and its value
+				STextSpan strs = xp.value;
+				size_t ev = 0;
+				for (size_t c = strs.len; c > 0; c--)
+				{
+					if (strs.p[c - 1] == _T(':'))
+					{
+						STextSpan num = {strs.p + c, strs.len - c};
+						int64_t i;
+						CValueParser::ParseInts(num, &i, 1);
+						ev = (size_t)i;
+						strs.len = c - 1;
+						break;
+					}
+				}
+
+				CXMLReader::Unescape(strs, v);
+				pp->SetEnumStrings(v.c_str());
+				pp->SetEnumVal(ev);
+				break;
+			}
+
+			default:
+				if (!SetValueFromText(pp, type, xp.value))
+				{
+					CXMLReader::Unescape(xp.value, v);
+					pp->SetString(v.c_str());
+				}
+				break;
+		}
+
+		if (xp.aspect.len)
+			pp->SetAspect(AspectFromName(xp.aspect));
+	}
+
+	return (r == CXMLReader::R_END);
+}
+
+
+// JSON strings escape quotes, backslashes and control characters; everything else is written as it is
+static void WriteJSONString(CTextWriter &w, const TCHAR *s)
+{
+	if (!s)
+		s = _T("");
+
+	w += _T('\"');
+
+	const TCHAR *run = s, *c = s;
+	for (; *c; c++)
+	{
+		if (((unsigned)*c >= 0x20) && (*c != _T('\"')) && (*c != _T('\\')))
+			continue;
+
+		w.Append(run, c - run);
+		run = c + 1;
+
+		switch (*c)
+		{
+			case _T('\"'): w += _T("\\\""); break;
+			case _T('\\'): w += _T("\\\\"); break;
+			case _T('\b'): w += _T("\\b"); break;
+			case _T('\f'): w += _T("\\f"); break;
+			case _T('\n'): w += _T("\\n"); break;
+			case _T('\r'): w += _T("\\r"); break;
+			case _T('\t'): w += _T("\\t"); break;
+
+			default:
+			{
+				static const TCHAR hex[] = _T("0123456789abcdef");
+				TCHAR u[6] = {_T('\\'), _T('u'), _T('0'), _T('0'), hex[(*c >> 4) & 0xF], hex[*c & 0xF]};
+				w.Append(u, _countof(u));
+				break;
+			}
+		}
+	}
+
+	w.Append(run, c - run);
+	w += _T('\"');
+}
+
+static void WriteJSONNumber(CTextWriter &w, int64_t v)
+{
+	TCHAR t[CValueFormatter::MAX_NUMBER_CHARS];
+	w.Append(t, CValueFormatter::Format(v, t));
+}
+
+// JSON has no way to write infinities or NaNs, so they become null
+static void WriteJSONNumber(CTextWriter &w, float v)
+{
+	if (std::isfinite(v))
+	{
+		TCHAR t[CValueFormatter::MAX_NUMBER_CHARS];
+		w.Append(t, CValueFormatter::Format(v, t));
+	}
+	else
+		w += _T("null");
+}
+
+template <typename T> static void WriteJSONArray(CTextWriter &w, const T *v, size_t n)
+{
+	w += _T('[');
+	for (size_t i = 0; i < n; i++)
+	{
+		if (i)
+			w += _T(", ");
+
+		WriteJSONNumber(w, v[i]);
+	}
+	w += _T(']');
+}
+
+bool CPropertySetBase::SerializeToJSONString(IProperty::SERIALIZE_MODE mode, tstring &jsons) const
+{
+	jsons.clear();
+	jsons.reserve(1 << 14);
+
+	CStringDataSink sink(jsons);
+	return SerializeToJSON(mode, &sink);
+}
+
+bool CPropertySetBase::SerializeToJSON(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
+{
+	if (!psink)
+		return false;
+
+	CTextWriter json(psink);
+
+	json += _T("{\"property_set\": [");
+
+	bool first = true;
+	for (size_t propidx = 0, maxidx = GetPropertyCount(); propidx < maxidx; propidx++)
+	{
+		IProperty *pprop = GetProperty(propidx);
+		if (!pprop)
+			continue;
+
+		json += first ? _T("\n{") : _T(",\n{");
+		first = false;
+
+		// the id's characters, most significant first, leaving out zeros as the XML does
+		TCHAR id[5];
+		size_t idlen = 0;
+		FOURCHARCODE fcc = pprop->GetID();
+		for (size_t i = 0; i < 4; i++)
+		{
+			TCHAR c = (TCHAR)((fcc >> (24 - (i * 8))) & 0xFF);
 			if (c)
+				id[idlen++] = c;
+		}
+		id[idlen] = _T('\0');
+
+		json += _T("\"id\": ");
+		WriteJSONString(json, id);
+
+		if (mode == props::IProperty::SERIALIZE_MODE::SM_BIN_VERBOSE)
+		{
+			json += _T(", \"name\": ");
+			WriteJSONString(json, pprop->GetName());
+		}
+
+		json += _T(", \"type\": \"");
+		json += TypeName(pprop->GetType());
+		json += _T("\"");
+
+		if (mode >= props::IProperty::SERIALIZE_MODE::SM_BIN_TERSE)
+		{
+			if (pprop->GetAspect() != props::IProperty::PROPERTY_ASPECT::PA_GENERIC)
+			{
+				json += _T(", \"aspect\": ");
+
+				// aspects without a name are plain numbers
+				TCHAR t[16];
+				const TCHAR *aspect = AspectName(pprop->GetAspect(), t, _countof(t));
+				if (aspect == t)
+					json += aspect;
+				else
+					WriteJSONString(json, aspect);
+			}
+
+			uint32_t flags = (uint32_t)pprop->Flags() & ~(PROPFLAG_REFERENCE | PROPFLAG_ENUMPROVIDER);
+			if (flags)
+			{
+				json += _T(", \"flags\": ");
+				WriteJSONNumber(json, (int64_t)flags);
+			}
+		}
+
+		if (pprop->GetType() == props::IProperty::PROPERTY_TYPE::PT_ENUM)
+		{
+			json += _T(", \"enum\": [");
+
+			TCHAR q[1 << 12];
+			for (size_t i = 0; i < pprop->GetMaxEnumVal(); i++)
+			{
+				if (i)
+					json += _T(", ");
+
+				q[0] = _T('\0');
+				WriteJSONString(json, pprop->GetEnumString(i, q, _countof(q)));
+			}
+
+			json += _T("]");
+		}
+
+		json += _T(", \"value\": ");
+
+		switch (pprop->GetType())
+		{
+			case props::IProperty::PROPERTY_TYPE::PT_BOOLEAN:
+				json += pprop->AsBool() ? _T("true") : _T("false");
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_INT:
+			case props::IProperty::PROPERTY_TYPE::PT_ENUM:
+				WriteJSONNumber(json, pprop->AsInt());
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_INT_V2:
+			{
+				props::TVec2I v;
+				WriteJSONArray(json, pprop->AsVec2I(&v)->v, 2);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_INT_V3:
+			{
+				props::TVec3I v;
+				WriteJSONArray(json, pprop->AsVec3I(&v)->v, 3);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_INT_V4:
+			{
+				props::TVec4I v;
+				WriteJSONArray(json, pprop->AsVec4I(&v)->v, 4);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT:
+				WriteJSONNumber(json, pprop->AsFloat());
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V2:
+			{
+				props::TVec2F v;
+				WriteJSONArray(json, pprop->AsVec2F(&v)->v, 2);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V3:
+			{
+				props::TVec3F v;
+				WriteJSONArray(json, pprop->AsVec3F(&v)->v, 3);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V4:
+			{
+				props::TVec4F v;
+				WriteJSONArray(json, pprop->AsVec4F(&v)->v, 4);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_MAT3X3:
+			{
+				props::TMat3x3F m;
+				pprop->AsMat3x3F(&m);
+
+				json += _T('[');
+				for (size_t row = 0; row < 3; row++)
+				{
+					if (row)
+						json += _T(", ");
+
+					WriteJSONArray(json, m.m[row].v, 3);
+				}
+				json += _T(']');
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_MAT4X4:
+			{
+				props::TMat4x4F m;
+				pprop->AsMat4x4F(&m);
+
+				json += _T('[');
+				for (size_t row = 0; row < 4; row++)
+				{
+					if (row)
+						json += _T(", ");
+
+					WriteJSONArray(json, m.m[row].v, 4);
+				}
+				json += _T(']');
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_GUID:
+			{
+				TCHAR g[64];
+				WriteJSONString(json, pprop->AsString(g, _countof(g)));
+				break;
+			}
+
+			default:
+				WriteJSONString(json, pprop->AsString());
+				break;
+		}
+
+		json += _T("}");
+	}
+
+	json += first ? _T("]}") : _T("\n]}");
+
+	return json.Flush();
+}
+
+bool CPropertySetBase::DeserializeFromJSON(const tstring &jsons)
+{
+	CJSONReader reader(jsons.c_str(), jsons.length());
+	CJSONReader::SProperty jp;
+	CJSONReader::RESULT r;
+
+	// reused for every property, so they stop allocating once they've grown to fit
+	tstring propname, v;
+
+	while ((r = reader.Next(jp)) == CJSONReader::R_PROPERTY)
+	{
+		FOURCHARCODE fcc;
+		if (!CJSONReader::DecodeID(jp.id, v, fcc))
+			return false;
+
+		CJSONReader::Unescape(jp.name, propname);
+
+		props::IProperty *pp = GetPropertyById(fcc);
+
+		if (!pp && !propname.empty())
+			pp = GetPropertyByName(propname.c_str());
+
+		if (!pp)
+			pp = CreateProperty(propname.c_str(), fcc);
+
+		if (!pp)
+			return false;
+
+		props::IProperty::PROPERTY_TYPE type = TypeFromName(CJSONReader::Unquote(jp.type));
+		switch (type)
+		{
+			case props::IProperty::PROPERTY_TYPE::PT_BOOLEAN:
+			{
+				bool b;
+				CValueParser::ParseBool(CJSONReader::Unquote(jp.value), b);
+				pp->SetBool(b);
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_ENUM:
+			{
+				if (jp.enumstrs.len)
+				{
+					if (!CJSONReader::JoinStrings(jp.enumstrs, v))
+						return false;
+
+					pp->SetEnumStrings(v.c_str());
+				}
+
+				int64_t i;
+				CValueParser::ParseInts(jp.value, &i, 1);
+				pp->SetEnumVal((size_t)i);
+				break;
+			}
+
+			default:
+				if (!SetValueFromText(pp, type, CJSONReader::Unquote(jp.value)))
+				{
+					CJSONReader::Unescape(jp.value, v);
+					pp->SetString(v.c_str());
+				}
+				break;
+		}
+
+		if (jp.aspect.len)
+			pp->SetAspect(AspectFromName(CJSONReader::Unquote(jp.aspect)));
+
+		// flags go on last, so TYPELOCKED or ASPECTLOCKED don't stop the rest from loading
+		if (jp.flags.len)
+		{
+			int64_t f;
+			CValueParser::ParseInts(jp.flags, &f, 1);
+
+			uint32_t internal_flags = PROPFLAG_REFERENCE | PROPFLAG_ENUMPROVIDER;
+			pp->Flags() = ((uint32_t)pp->Flags() & internal_flags) | ((uint32_t)f & ~internal_flags);
+		}
+	}
+
+	return (r == CJSONReader::R_END);
+}
+
+
+// Schema-backed property sets: each property's metadata (and default value) lives once in a prototype CProperty owned by
+// the schema, while every set made from the schema stores only a packed block of values
+
+class CSchemaPropertySet;
+
+class CPropertySchema : public IPropertySchema
+{
+public:
+	// the name, id, type, aspect, flags and enum strings of each property, along with its default value
+	typedef ::std::vector<CProperty *> TPrototypeArray;
+	TPrototypeArray m_Protos;
+
+	// where each property's value sits in a set's value block
+	typedef ::std::vector<size_t> TOffsetArray;
+	TOffsetArray m_Offsets;
+	size_t m_ValueSize;
+
+	typedef CFourCCMap<size_t> TIndexMap;
+	TIndexMap m_mapIds;
+
+	// keyed the same way as CPropertySet's name index
+	typedef ::std::unordered_multimap<CNamePool::TNameView, size_t> TNameMap;
+	TNameMap m_mapNames;
+
+	// a value block holding the prototypes' values; its string slots point at the prototypes' own strings
+	uint8_t *m_pDefaults;
+
+	// one for the creator plus one for each set made from the schema
+	::std::atomic<size_t> m_Refs;
+
+	CPropertySchema(const IPropertySet *prototype);
+	virtual ~CPropertySchema();
+
+	void AddRef() { m_Refs++; }
+
+	virtual void Release();
+	virtual size_t GetPropertyCount() const { return m_Protos.size(); }
+	virtual size_t GetValueSize() const { return m_ValueSize; }
+	virtual IPropertySet *CreatePropertySet();
+
+	// return the index of the property with the given id or name, or -1 if there isn't one
+	size_t FindById(FOURCHARCODE propid) const;
+	size_t FindByName(const TCHAR *propname) const;
+
+	// the space a value of the given type takes in a value block, and the alignment it needs there
+	static size_t ValueSize(IProperty::PROPERTY_TYPE type);
+	static size_t ValueAlignment(IProperty::PROPERTY_TYPE type);
+
+	// copies a (non-reference) property's value into a value block slot of the same type; strings are copied by pointer
+	static void CopyValue(uint8_t *slot, const CProperty *src);
+};
+
+
+class CSchemaProperty;
+
+// a CProperty holding a copy of a schema property's value, so that conversions, comparisons and serialization can reuse
+// CProperty's code; the name, enum strings and string value are borrowed, and given back before CProperty can free them
+class CSchemaPropertyCopy : public CProperty
+{
+public:
+	CSchemaPropertyCopy(const CSchemaProperty *pprop);
+	virtual ~CSchemaPropertyCopy();
+};
+
+
+// a property of a schema-backed set; its metadata belongs to the schema and its value to the set's value block
+class CSchemaProperty : public IProperty
+{
+public:
+	CSchemaPropertySet *m_pOwner;
+	size_t m_Index;
+
+	CSchemaProperty(CSchemaPropertySet *powner, size_t idx) : m_pOwner(powner), m_Index(idx) { }
+
+	CProperty *Proto() const;
+
+	// where the value is kept; nullptr if the set no longer has one (a row view whose row was removed)
+	uint8_t *Slot() const;
+
+	// the slot, if the property is of the given type and has one
+	uint8_t *Slot(PROPERTY_TYPE type) const
+	{
+		return (GetType() == type) ? Slot() : nullptr;
+	}
+
+	// writes a value of any type into the slot, converting it to the schema's type; returns false if it can't be
+	bool Store(CProperty &val);
+
+	void Changed();
+
+	// owned by the set
+	virtual void Release()
+	{
+	}
+
+	virtual const TCHAR *GetName() const
+	{
+		return Proto()->GetName();
+	}
+
+	// the name, id, type, aspect and enum strings are the schema's, so they can't be changed through a single set
+	virtual void SetName(const TCHAR *name)
+	{
+	}
+
+	virtual FOURCHARCODE GetID() const
+	{
+		return Proto()->m_ID;
+	}
+
+	virtual void SetID(FOURCHARCODE id)
+	{
+	}
+
+	// shared by every set made from the schema
+	virtual TFlags32 &Flags()
+	{
+		return Proto()->m_Flags;
+	}
+
+	virtual PROPERTY_TYPE GetType() const
+	{
+		return Proto()->m_Type;
+	}
+
+	virtual bool ConvertTo(PROPERTY_TYPE newtype)
+	{
+		return (newtype == GetType());
+	}
+
+	virtual PROPERTY_ASPECT GetAspect() const
+	{
+		return Proto()->m_Aspect;
+	}
+
+	virtual void SetAspect(PROPERTY_ASPECT aspect)
+	{
+	}
+
+	virtual void SetFromProperty(IProperty *pprop, bool overwrite_flags)
+	{
+		// flags belong to the schema, so overwrite_flags doesn't apply
+		if (!pprop)
+			return;
+
+		// an enum provider's value can't be copied into a scratch CProperty, but its ordinal is all that's needed
+		if ((pprop->GetType() == PT_ENUM) && (GetType() == PT_ENUM))
+		{
+			SetEnumVal((size_t)pprop->AsInt());
+			return;
+		}
+
+		CProperty tmp(nullptr);
+		tmp.SetFromProperty(pprop, false);
+		Store(tmp);
+	}
+
+	virtual void SetInt(int64_t val)
+	{
+		if (GetType() != PT_INT)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetInt(val);
+			Store(tmp);
+			return;
+		}
+
+		int64_t *slot = (int64_t *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetVec2I(const TVec2I &val)
+	{
+		if (GetType() != PT_INT_V2)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetVec2I(val);
+			Store(tmp);
+			return;
+		}
+
+		TVec2I *slot = (TVec2I *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetVec3I(const TVec3I &val)
+	{
+		if (GetType() != PT_INT_V3)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetVec3I(val);
+			Store(tmp);
+			return;
+		}
+
+		TVec3I *slot = (TVec3I *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetVec4I(const TVec4I &val)
+	{
+		if (GetType() != PT_INT_V4)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetVec4I(val);
+			Store(tmp);
+			return;
+		}
+
+		TVec4I *slot = (TVec4I *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetFloat(float val)
+	{
+		if (GetType() != PT_FLOAT)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetFloat(val);
+			Store(tmp);
+			return;
+		}
+
+		float *slot = (float *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetVec2F(const TVec2F &val)
+	{
+		if (GetType() != PT_FLOAT_V2)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetVec2F(val);
+			Store(tmp);
+			return;
+		}
+
+		TVec2F *slot = (TVec2F *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetVec3F(const TVec3F &val)
+	{
+		if (GetType() != PT_FLOAT_V3)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetVec3F(val);
+			Store(tmp);
+			return;
+		}
+
+		TVec3F *slot = (TVec3F *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetVec4F(const TVec4F &val)
+	{
+		if (GetType() != PT_FLOAT_V4)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetVec4F(val);
+			Store(tmp);
+			return;
+		}
+
+		TVec4F *slot = (TVec4F *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetString(const TCHAR *val)
+	{
+		CProperty tmp(nullptr);
+		tmp.SetString(val ? val : _T(""));
+		Store(tmp);
+	}
+
+	virtual void SetGUID(GUID val)
+	{
+		if (GetType() != PT_GUID)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetGUID(val);
+			Store(tmp);
+			return;
+		}
+
+		GUID *slot = (GUID *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetBool(bool val)
+	{
+		if (GetType() != PT_BOOLEAN)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetBool(val);
+			Store(tmp);
+			return;
+		}
+
+		bool *slot = (bool *)Slot();
+		if (!slot)
+			return;
+
+		*slot = val;
+		Changed();
+	}
+
+	virtual void SetMat3x3F(const TMat3x3F *val)
+	{
+		if (!val)
+			return;
+
+		if (GetType() != PT_FLOAT_MAT3X3)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetMat3x3F(val);
+			Store(tmp);
+			return;
+		}
+
+		TMat3x3F *slot = (TMat3x3F *)Slot();
+		if (!slot)
+			return;
+
+		*slot = *val;
+		Changed();
+	}
+
+	virtual void SetMat4x4F(const TMat4x4F *val)
+	{
+		if (!val)
+			return;
+
+		if (GetType() != PT_FLOAT_MAT4X4)
+		{
+			CProperty tmp(nullptr);
+			tmp.SetMat4x4F(val);
+			Store(tmp);
+			return;
+		}
+
+		TMat4x4F *slot = (TMat4x4F *)Slot();
+		if (!slot)
+			return;
+
+		*slot = *val;
+		Changed();
+	}
+
+	// values that are already the requested type are read straight from the slot, so returned pointers stay valid;
+	// anything else is converted by a CProperty copy
+
+	virtual int64_t AsInt(int64_t *ret) const
+	{
+		const int64_t *slot = (const int64_t *)Slot(PT_INT);
+		if (slot)
+		{
+			int64_t v = *slot;
+			if (ret)
+				*ret = v;
+			return v;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsInt(ret);
+	}
+
+	virtual const TVec2I *AsVec2I(TVec2I *ret) const
+	{
+		TVec2I *v = (TVec2I *)Slot(PT_INT_V2);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsVec2I(ret);
+	}
+
+	virtual const TVec3I *AsVec3I(TVec3I *ret) const
+	{
+		TVec3I *v = (TVec3I *)Slot(PT_INT_V3);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsVec3I(ret);
+	}
+
+	virtual const TVec4I *AsVec4I(TVec4I *ret) const
+	{
+		TVec4I *v = (TVec4I *)Slot(PT_INT_V4);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsVec4I(ret);
+	}
+
+	virtual float AsFloat(float *ret) const
+	{
+		const float *slot = (const float *)Slot(PT_FLOAT);
+		if (slot)
+		{
+			float v = *slot;
+			if (ret)
+				*ret = v;
+			return v;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsFloat(ret);
+	}
+
+	virtual const TVec2F *AsVec2F(TVec2F *ret) const
+	{
+		TVec2F *v = (TVec2F *)Slot(PT_FLOAT_V2);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsVec2F(ret);
+	}
+
+	virtual const TVec3F *AsVec3F(TVec3F *ret) const
+	{
+		TVec3F *v = (TVec3F *)Slot(PT_FLOAT_V3);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsVec3F(ret);
+	}
+
+	virtual const TVec4F *AsVec4F(TVec4F *ret) const
+	{
+		TVec4F *v = (TVec4F *)Slot(PT_FLOAT_V4);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsVec4F(ret);
+	}
+
+	// the copy borrows the slot's string and the schema's enum strings, so a returned pointer outlives it
+	virtual const TCHAR *AsString(TCHAR *ret, size_t retsize) const
+	{
+		CSchemaPropertyCopy c(this);
+		return c.AsString(ret, retsize);
+	}
+
+	virtual GUID AsGUID(GUID *ret) const
+	{
+		const GUID *slot = (const GUID *)Slot(PT_GUID);
+		if (slot)
+		{
+			GUID v = *slot;
+			if (ret)
+				*ret = v;
+			return v;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsGUID(ret);
+	}
+
+	virtual bool AsBool(bool *ret) const
+	{
+		const bool *slot = (const bool *)Slot(PT_BOOLEAN);
+		if (slot)
+		{
+			bool v = *slot;
+			if (ret)
+				*ret = v;
+			return v;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsBool(ret);
+	}
+
+	virtual const TMat3x3F *AsMat3x3F(TMat3x3F *ret) const
+	{
+		TMat3x3F *v = (TMat3x3F *)Slot(PT_FLOAT_MAT3X3);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsMat3x3F(ret);
+	}
+
+	virtual const TMat4x4F *AsMat4x4F(TMat4x4F *ret) const
+	{
+		TMat4x4F *v = (TMat4x4F *)Slot(PT_FLOAT_MAT4X4);
+		if (v)
+		{
+			if (!ret)
+				return v;
+			*ret = *v;
+			return ret;
+		}
+
+		CSchemaPropertyCopy c(this);
+		return c.AsMat4x4F(ret);
+	}
+
+	virtual void SetEnumProvider(const IEnumProvider *pep)
+	{
+	}
+
+	virtual const IEnumProvider *GetEnumProvider() const
+	{
+		return Proto()->GetEnumProvider();
+	}
+
+	virtual void SetEnumStrings(const TCHAR *strs)
+	{
+	}
+
+	virtual bool SetEnumVal(size_t val)
+	{
+		uint64_t *slot = (uint64_t *)Slot(PT_ENUM);
+		if (!slot || (val >= GetMaxEnumVal()))
+			return false;
+
+		*slot = val;
+		Changed();
+
+		return true;
+	}
+
+	virtual bool SetEnumValByString(const TCHAR *s)
+	{
+		if ((GetType() != PT_ENUM) || !s)
+			return false;
+
+		CSchemaPropertyCopy c(this);
+		if (!c.SetEnumValByString(s))
+			return false;
+
+		*((uint64_t *)Slot()) = c.m_e;
+		Changed();
+
+		return true;
+	}
+
+	virtual const TCHAR *GetEnumString(size_t idx, TCHAR *ret, size_t retsize) const
+	{
+		return Proto()->GetEnumString(idx, ret, retsize);
+	}
+
+	virtual const TCHAR *GetEnumStrings(TCHAR *ret, size_t retsize) const
+	{
+		return Proto()->GetEnumStrings(ret, retsize);
+	}
+
+	virtual size_t GetMaxEnumVal() const
+	{
+		return Proto()->GetMaxEnumVal();
+	}
+
+	virtual IPropertySet *GetOwner() const;
+
+	virtual bool IsSameAs(const IProperty *other_prop) const
+	{
+		CSchemaPropertyCopy c(this);
+		return c.IsSameAs(other_prop);
+	}
+
+	// schema values are never references
+	virtual void ExternalizeReference()
+	{
+	}
+};
+
+
+class CSchemaPropertySet : public CPropertySetBase
+{
+public:
+	CPropertySchema *m_pSchema;
+
+	// every property's value, laid out as the schema's offsets describe; null if the values are kept elsewhere
+	uint8_t *m_pValues;
+
+protected:
+	// what GetProperty and friends hand out; made by the constructor and never changed after that, so const
+	// lookups from several threads at once are safe
+	typedef ::std::vector<CSchemaProperty> TProxyArray;
+	TProxyArray m_Proxies;
+
+	CSchemaProperty *Proxy(size_t idx) const;
+
+public:
+	// change stamps as CPropertySet keeps them, one per schema property; schema properties are never deleted, so there is no deletion log
+	uint64_t m_Stamp;
+	typedef ::std::vector<uint64_t> TStampArray;
+	TStampArray m_Stamps;
+
+
+	// sets that don't own a value block must override SlotAddress
+	CSchemaPropertySet(CPropertySchema *pschema, bool ownvalues = true);
+	virtual ~CSchemaPropertySet();
+
+	// where the value of the property at idx is stored
+	virtual uint8_t *SlotAddress(size_t idx) const
+	{
+		return m_pValues + m_pSchema->m_Offsets[idx];
+	}
+
+	// false when there are no values to get at, as with a row view whose row has been removed; the set then has
+	// no properties, and SlotAddress must not be called
+	virtual bool HasValues() const
+	{
+		return true;
+	}
+
+	virtual void Release();
+	virtual IProperty *CreateProperty(const TCHAR *propname, FOURCHARCODE propid);
+	virtual IProperty *CreateReferenceProperty(const TCHAR *propname, FOURCHARCODE propid, void *addr, IProperty::PROPERTY_TYPE type);
+	virtual size_t CreateProperties(const SPropertyDesc *descs, size_t count);
+	virtual void DeleteProperty(size_t idx);
+	virtual void DeletePropertyById(FOURCHARCODE propid);
+	virtual void DeletePropertyByName(const TCHAR *propname);
+	virtual void DeletePropertyByHandle(PropertyHandle handle);
+	virtual void DeleteAll();
+	virtual size_t GetPropertyCount() const;
+	virtual IProperty *GetProperty(size_t idx) const;
+	virtual IProperty *GetPropertyById(props::FOURCHARCODE propid) const;
+	virtual IProperty *operator [](FOURCHARCODE propid) const { return GetPropertyById(propid); }
+	virtual IProperty *GetPropertyByName(const TCHAR *propname) const;
+	virtual IProperty *operator [](const TCHAR *propname) const { return GetPropertyByName(propname); }
+	virtual PropertyHandle GetPropertyHandle(FOURCHARCODE propid) const;
+	virtual IProperty *GetPropertyByHandle(PropertyHandle handle) const;
+	using CPropertySetBase::Serialize;
+	virtual bool Serialize(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
+	virtual bool Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed);
+	virtual bool SerializeChunked(IProperty::SERIALIZE_MODE mode, IDataSink *psink, size_t chunksize) const;
+	virtual bool SerializeArchive(IDataSink *psink) const;
+	virtual uint64_t GetCheckpoint() const;
+	virtual bool SerializeDelta(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
+	virtual void TrimDeltaHistory(uint64_t checkpoint);
+
+	// writes the properties changed since checkpoint in Serialize's format
+	bool SerializeProperties(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const;
+
+	// reads a SM_BIN_COMPACT set; Deserialize hands these off
+	bool DeserializeCompact(BYTE *buf, size_t bufsize, size_t *bytesconsumed);
+
+	// reads a SM_BIN_ALIGNED set, as DeserializeCompact does
+	bool DeserializeAligned(BYTE *buf, size_t bufsize, size_t *bytesconsumed);
+
+	// replaces the string held in a value block slot with a copy of s
+	void StoreString(uint8_t *slot, const TCHAR *s);
+};
+
+
+CPropertySchema::CPropertySchema(const IPropertySet *prototype)
+{
+	m_Refs = 1;
+	m_ValueSize = 0;
+	m_pDefaults = nullptr;
+
+	size_t n = prototype ? prototype->GetPropertyCount() : 0;
+	m_Protos.reserve(n);
+	m_mapIds.Reserve(n);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		IProperty *p = prototype->GetProperty(i);
+		if (!p || (FindById(p->GetID()) != (size_t)-1))
+			continue;
+
+		CProperty *proto = new CProperty(nullptr);
+		proto->AssignName(p->GetName());
+		proto->SetID(p->GetID());
+
+		if (p->GetEnumProvider())
+			proto->SetEnumProvider(p->GetEnumProvider());
+
+		proto->SetFromProperty(p, false);
+
+		// take the user's flags; the internal ones describe how the prototype itself holds its value
+		uint32_t internal_flags = PROPFLAG_REFERENCE | PROPFLAG_ENUMPROVIDER;
+		proto->m_Flags = ((uint32_t)proto->m_Flags & internal_flags) | ((uint32_t)p->Flags() & ~internal_flags);
+
+		m_mapIds.Insert(proto->m_ID, m_Protos.size());
+		m_mapNames.insert(TNameMap::value_type(proto->NameKey(), m_Protos.size()));
+		m_Protos.push_back(proto);
+	}
+
+	// every value's size is a multiple of its alignment, so placing them by decreasing alignment leaves no padding
+	m_Offsets.resize(m_Protos.size());
+	for (size_t align = sizeof(int64_t); align > 0; align >>= 1)
+	{
+		for (size_t i = 0; i < m_Protos.size(); i++)
+		{
+			if (ValueAlignment(m_Protos[i]->m_Type) != align)
+				continue;
+
+			m_Offsets[i] = m_ValueSize;
+			m_ValueSize += ValueSize(m_Protos[i]->m_Type);
+		}
+	}
+
+	m_pDefaults = (uint8_t *)calloc(1, m_ValueSize ? m_ValueSize : 1);
+	if (m_pDefaults)
+	{
+		for (size_t i = 0; i < m_Protos.size(); i++)
+			CopyValue(m_pDefaults + m_Offsets[i], m_Protos[i]);
+	}
+}
+
+CPropertySchema::~CPropertySchema()
+{
+	free(m_pDefaults);
+
+	for (TPrototypeArray::iterator it = m_Protos.begin(), last_it = m_Protos.end(); it != last_it; it++)
+		(*it)->Release();
+}
+
+void CPropertySchema::Release()
+{
+	if (!--m_Refs)
+		delete this;
+}
+
+IPropertySet *CPropertySchema::CreatePropertySet()
+{
+	return new CSchemaPropertySet(this);
+}
+
+size_t CPropertySchema::FindById(FOURCHARCODE propid) const
+{
+	const size_t *pi = m_mapIds.Find(propid);
+	return pi ? *pi : (size_t)-1;
+}
+
+size_t CPropertySchema::FindByName(const TCHAR *propname) const
+{
+	if (!propname)
+		return (size_t)-1;
+
+	TNameMap::const_iterator n = m_mapNames.find(CNamePool::CLookupKey(propname));
+	return (n != m_mapNames.end()) ? n->second : (size_t)-1;
+}
+
+size_t CPropertySchema::ValueSize(IProperty::PROPERTY_TYPE type)
+{
+	switch (type)
+	{
+		case IProperty::PT_STRING:
+			return sizeof(TCHAR *);
+
+		case IProperty::PT_INT:
+		case IProperty::PT_ENUM:
+			return sizeof(int64_t);
+
+		case IProperty::PT_INT_V2:
+			return sizeof(TVec2I);
+
+		case IProperty::PT_INT_V3:
+			return sizeof(TVec3I);
+
+		case IProperty::PT_INT_V4:
+			return sizeof(TVec4I);
+
+		case IProperty::PT_FLOAT:
+			return sizeof(float);
+
+		case IProperty::PT_FLOAT_V2:
+			return sizeof(TVec2F);
+
+		case IProperty::PT_FLOAT_V3:
+			return sizeof(TVec3F);
+
+		case IProperty::PT_FLOAT_V4:
+			return sizeof(TVec4F);
+
+		case IProperty::PT_GUID:
+			return sizeof(GUID);
+
+		case IProperty::PT_BOOLEAN:
+			return sizeof(bool);
+
+		case IProperty::PT_FLOAT_MAT3X3:
+			return sizeof(TMat3x3F);
+
+		case IProperty::PT_FLOAT_MAT4X4:
+			return sizeof(TMat4x4F);
+	}
+
+	return 0;
+}
+
+size_t CPropertySchema::ValueAlignment(IProperty::PROPERTY_TYPE type)
+{
+	switch (type)
+	{
+		case IProperty::PT_STRING:
+			return sizeof(TCHAR *);
+
+		case IProperty::PT_INT:
+		case IProperty::PT_ENUM:
+		case IProperty::PT_INT_V2:
+		case IProperty::PT_INT_V3:
+		case IProperty::PT_INT_V4:
+			return sizeof(int64_t);
+
+		case IProperty::PT_FLOAT:
+		case IProperty::PT_FLOAT_V2:
+		case IProperty::PT_FLOAT_V3:
+		case IProperty::PT_FLOAT_V4:
+		case IProperty::PT_FLOAT_MAT3X3:
+		case IProperty::PT_FLOAT_MAT4X4:
+		case IProperty::PT_GUID:
+			return sizeof(float);
+
+		case IProperty::PT_BOOLEAN:
+			return sizeof(bool);
+	}
+
+	// untyped properties take no space, so they can go anywhere
+	return 1;
+}
+
+void CPropertySchema::CopyValue(uint8_t *slot, const CProperty *src)
+{
+	switch (src->m_Type)
+	{
+		case IProperty::PT_NONE:
+			break;
+
+		case IProperty::PT_STRING:
+			*((const TCHAR **)slot) = src->Str();
+			break;
+
+		default:
+			memcpy(slot, src->ValueAddress(), ValueSize(src->m_Type));
+			break;
+	}
+}
+
+
+CSchemaPropertyCopy::CSchemaPropertyCopy(const CSchemaProperty *pprop) : CProperty(nullptr)
+{
+	const CProperty *proto = pprop->Proto();
+	const uint8_t *slot = pprop->Slot();
+
+	m_sName = proto->m_sName;
+	m_ID = proto->m_ID;
+	m_Aspect = proto->m_Aspect;
+	m_Flags = proto->m_Flags;
+
+	// with no value to copy, it reads as empty
+	m_Type = slot ? proto->m_Type : PT_NONE;
+
+	switch (m_Type)
+	{
+		case PT_NONE:
+			break;
+
+		case PT_STRING:
+		{
+			const TCHAR *s = *((const TCHAR **)slot);
+			m_s = (TCHAR *)(s ? s : _T(""));
+			break;
+		}
+
+		case PT_ENUM:
+			m_e = *((const uint64_t *)slot);
+			if (m_Flags.IsSet(PROPFLAG_ENUMPROVIDER))
+				m_pep = proto->m_pep;
+			else
+			{
+				m_s = proto->m_s;
+				m_ec = proto->m_ec;
+			}
+			break;
+
+		default:
+			memcpy(ValueAddress(), slot, CPropertySchema::ValueSize(m_Type));
+			break;
+	}
+}
+
+CSchemaPropertyCopy::~CSchemaPropertyCopy()
+{
+	// with no type and no name, CProperty's destructor has nothing left to free
+	m_sName = nullptr;
+	m_Type = PT_NONE;
+}
+
+
+CProperty *CSchemaProperty::Proto() const
+{
+	return m_pOwner->m_pSchema->m_Protos[m_Index];
+}
+
+uint8_t *CSchemaProperty::Slot() const
+{
+	return m_pOwner->HasValues() ? m_pOwner->SlotAddress(m_Index) : nullptr;
+}
+
+bool CSchemaProperty::Store(CProperty &val)
+{
+	PROPERTY_TYPE t = GetType();
+
+	// a bare enum string selects that value; otherwise strings are converted the usual way, as "strings:value"
+	if ((t == PT_ENUM) && (val.m_Type == PT_STRING) && val.Str() && SetEnumValByString(val.Str()))
+		return true;
+
+	uint8_t *slot = Slot();
+	if (!slot)
+		return false;
+
+	if ((val.m_Type != t) && (!val.ConvertTo(t) || (val.m_Type != t)))
+		return false;
+
+	switch (t)
+	{
+		case PT_NONE:
+			return false;
+
+		case PT_STRING:
+			m_pOwner->StoreString(slot, val.Str());
+			break;
+
+		case PT_ENUM:
+			if (val.m_e >= GetMaxEnumVal())
+				return false;
+			*((uint64_t *)slot) = val.m_e;
+			break;
+
+		default:
+			CPropertySchema::CopyValue(slot, &val);
+			break;
+	}
+
+	Changed();
+
+	return true;
+}
+
+void CSchemaProperty::Changed()
+{
+	m_pOwner->m_Stamps[m_Index] = ++m_pOwner->m_Stamp;
+
+	if (m_pOwner->m_pListener)
+		m_pOwner->m_pListener->PropertyChanged(this);
+}
+
+IPropertySet *CSchemaProperty::GetOwner() const
+{
+	return m_pOwner;
+}
+
+
+bool CProperty::IsSchemaProperty(const IProperty *pprop)
+{
+	return (dynamic_cast<const CSchemaProperty *>(pprop) != nullptr);
+}
+
+
+CSchemaPropertySet::CSchemaPropertySet(CPropertySchema *pschema, bool ownvalues)
+{
+	m_pSchema = pschema;
+	m_pSchema->AddRef();
+
+	// every property starts out changed, so a delta from checkpoint 0 carries the whole set
+	m_Stamp = 1;
+	m_Stamps.resize(m_pSchema->m_Protos.size(), m_Stamp);
+
+	m_Proxies.reserve(m_pSchema->m_Protos.size());
+	for (size_t i = 0, maxi = m_pSchema->m_Protos.size(); i < maxi; i++)
+		m_Proxies.push_back(CSchemaProperty(this, i));
+
+	size_t sz = m_pSchema->m_ValueSize;
+	m_pValues = ownvalues ? (uint8_t *)malloc(sz ? sz : 1) : nullptr;
+	if (m_pValues)
+		memcpy(m_pValues, m_pSchema->m_pDefaults, sz);
+
+	// the defaults only point at the prototypes' strings; each set needs its own copies
+	for (size_t i = 0, maxi = m_pSchema->m_Protos.size(); m_pValues && (i < maxi); i++)
+	{
+		if (m_pSchema->m_Protos[i]->m_Type != IProperty::PT_STRING)
+			continue;
+
+		TCHAR **ps = (TCHAR **)(m_pValues + m_pSchema->m_Offsets[i]);
+		*ps = *ps ? _tcsdup(*ps) : nullptr;
+	}
+}
+
+CSchemaPropertySet::~CSchemaPropertySet()
+{
+	for (size_t i = 0, maxi = m_pSchema->m_Protos.size(); m_pValues && (i < maxi); i++)
+	{
+		if (m_pSchema->m_Protos[i]->m_Type == IProperty::PT_STRING)
+			free(*((TCHAR **)(m_pValues + m_pSchema->m_Offsets[i])));
+	}
+
+	free(m_pValues);
+
+	m_pSchema->Release();
+}
+
+void CSchemaPropertySet::Release()
+{
+	delete this;
+}
+
+CSchemaProperty *CSchemaPropertySet::Proxy(size_t idx) const
+{
+	if (!HasValues())
+		return nullptr;
+
+	return (CSchemaProperty *)&m_Proxies[idx];
+}
+
+// the shape of the set is fixed by its schema, so this can only find a property that's already there
+IProperty *CSchemaPropertySet::CreateProperty(const TCHAR *propname, FOURCHARCODE propid)
+{
+	IProperty *pprop = GetPropertyById(propid);
+
+	// as with any other set, the listener is told about an existing property's value
+	if (pprop && m_pListener)
+		m_pListener->PropertyChanged(pprop);
+
+	return pprop;
+}
+
+IProperty *CSchemaPropertySet::CreateReferenceProperty(const TCHAR *propname, FOURCHARCODE propid, void *addr, IProperty::PROPERTY_TYPE type)
+{
+	return nullptr;
+}
+
+// schema sets have a fixed set of properties, so there is never anything to create
+size_t CSchemaPropertySet::CreateProperties(const SPropertyDesc *descs, size_t count)
+{
+	return 0;
+}
+
+void CSchemaPropertySet::DeleteProperty(size_t idx)
+{
+}
+
+void CSchemaPropertySet::DeletePropertyById(FOURCHARCODE propid)
+{
+}
+
+void CSchemaPropertySet::DeletePropertyByName(const TCHAR *propname)
+{
+}
+
+void CSchemaPropertySet::DeletePropertyByHandle(PropertyHandle handle)
+{
+}
+
+void CSchemaPropertySet::DeleteAll()
+{
+}
+
+size_t CSchemaPropertySet::GetPropertyCount() const
+{
+	return HasValues() ? m_pSchema->m_Protos.size() : 0;
+}
+
+IProperty *CSchemaPropertySet::GetProperty(size_t idx) const
+{
+	if (idx < m_pSchema->m_Protos.size())
+		return Proxy(idx);
+
+	return NULL;
+}
+
+IProperty *CSchemaPropertySet::GetPropertyById(props::FOURCHARCODE propid) const
+{
+	size_t idx = m_pSchema->FindById(propid);
+	if (idx != (size_t)-1)
+		return Proxy(idx);
+
+	return NULL;
+}
+
+IProperty *CSchemaPropertySet::GetPropertyByName(const TCHAR *propname) const
+{
+	size_t idx = m_pSchema->FindByName(propname);
+	if (idx != (size_t)-1)
+		return Proxy(idx);
+
+	return NULL;
+}
+
+// schema properties can't be deleted, so a handle is just the schema index and never goes stale
+PropertyHandle CSchemaPropertySet::GetPropertyHandle(FOURCHARCODE propid) const
+{
+	PropertyHandle ret = {0, 0};
+
+	size_t idx = m_pSchema->FindById(propid);
+	if (idx != (size_t)-1)
+	{
+		ret.index = (uint32_t)idx;
+		ret.generation = 1;
+	}
+
+	return ret;
+}
+
+IProperty *CSchemaPropertySet::GetPropertyByHandle(PropertyHandle handle) const
+{
+	if ((handle.generation == 1) && (handle.index < m_pSchema->m_Protos.size()))
+		return Proxy(handle.index);
+
+	return NULL;
+}
+
+// written in exactly the same format as CPropertySet's, so either kind of set can read what the other wrote
+bool CSchemaPropertySet::SerializeArchive(IDataSink *psink) const
+{
+	if (!HasValues())
+		return false;
+
+	size_t n = m_pSchema->m_Protos.size();
+
+	CArchiveWriter w(n);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		CSchemaProperty p((CSchemaPropertySet *)this, i);
+		CSchemaPropertyCopy c(&p);
+
+		w.Add(&c);
+	}
+
+	return w.End(psink);
+}
+
+bool CSchemaPropertySet::SerializeChunked(IProperty::SERIALIZE_MODE mode, IDataSink *psink, size_t chunksize) const
+{
+	if (!HasValues())
+		return false;
+
+	size_t n = m_pSchema->m_Protos.size();
+
+	CChunkWriter w(mode, psink, chunksize, n);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		CSchemaProperty p((CSchemaPropertySet *)this, i);
+		CSchemaPropertyCopy c(&p);
+
+		if (!w.Add(&c))
+			return false;
+	}
+
+	return w.End();
+}
+
+bool CSchemaPropertySet::Serialize(IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
+{
+	return SerializeProperties(0, mode, psink);
+}
+
+bool CSchemaPropertySet::SerializeProperties(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
+{
+	if (!psink || !HasValues())
+		return false;
+
+	size_t n = m_pSchema->m_Protos.size();
+
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (m_Stamps[i] > checkpoint)
+			count++;
+	}
+
+	CCompactWriter w(psink);
+	CAlignedWriter aw(psink);
+	if (mode == IProperty::SM_BIN_COMPACT)
+	{
+		w.BeginSet(count);
+	}
+	else if (mode == IProperty::SM_BIN_ALIGNED)
+	{
+		aw.BeginSet(count);
+	}
+	else
+	{
+		// the other modes' count is a short, whose negative values mark the other kinds of set
+		if (count > SHRT_MAX)
+			return false;
+
+		short numprops = short(count);
+		if (!psink->Write(&numprops, sizeof(short)))
+			return false;
+	}
+
+	for (size_t i = 0; i < n; i++)
+	{
+		if (m_Stamps[i] <= checkpoint)
+			continue;
+
+		CSchemaProperty p((CSchemaPropertySet *)this, i);
+		CSchemaPropertyCopy c(&p);
+
+		if (mode == IProperty::SM_BIN_COMPACT)
+			c.SerializeCompact(w);
+		else if (mode == IProperty::SM_BIN_ALIGNED)
+			c.SerializeAligned(aw);
+		else if (!c.Serialize(mode, psink))
+			return false;
+	}
+
+	if (mode == IProperty::SM_BIN_COMPACT)
+		return w.EndSet();
+
+	return (mode == IProperty::SM_BIN_ALIGNED) ? aw.OK() : true;
+}
+
+uint64_t CSchemaPropertySet::GetCheckpoint() const
+{
+	return m_Stamp;
+}
+
+bool CSchemaPropertySet::SerializeDelta(uint64_t checkpoint, IProperty::SERIALIZE_MODE mode, IDataSink *psink) const
+{
+	if (!psink || !WriteDeltaHeader(psink, false, nullptr, 0))
+		return false;
+
+	return SerializeProperties(checkpoint, mode, psink);
+}
+
+void CSchemaPropertySet::TrimDeltaHistory(uint64_t checkpoint)
+{
+}
+
+bool CSchemaPropertySet::Deserialize(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
+{
+	if (!buf || !HasValues())
+		return false;
+
+	if (CCompactReader::IsCompact(buf, bufsize))
+		return DeserializeCompact(buf, bufsize, bytesconsumed);
+
+	if (CAlignedReader::IsAlignedSet(buf, bufsize))
+		return DeserializeAligned(buf, bufsize, bytesconsumed);
+
+	short numprops = *((short *)buf);
+	buf += sizeof(short);
+	bufsize -= sizeof(short);
+	size_t remaining = bufsize;
+
+	size_t consumed = sizeof(short);
+
+	for (short i = 0; i < numprops; i++)
+	{
+		// read each record into a scratch property, then keep its value if the schema has a property with that id
+		CProperty tmp(nullptr);
+
+		size_t bc = 0;
+		if (!tmp.Deserialize(buf, remaining, &bc))
+			return false;
+
+		size_t idx = m_pSchema->FindById(tmp.m_ID);
+		if (idx != (size_t)-1)
+		{
+			Proxy(idx)->Store(tmp);
+			m_Stamps[idx] = ++m_Stamp;
+		}
+
+		consumed += bc;
+
+		buf += bc;
+		remaining -= bc;
+
+		if (remaining > bufsize)
+			return false;
+	}
+
+	if (bytesconsumed)
+		*bytesconsumed = consumed;
+
+	return true;
+}
+
+bool CSchemaPropertySet::DeserializeCompact(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
+{
+	CCompactReader r(buf, bufsize);
+
+	size_t numprops;
+	if (!r.BeginSet(&numprops))
+		return false;
+
+	// the schema indices of the booleans, or -1 for those the schema doesn't have, in the order their bits appear
+	::std::vector<size_t> bools;
+
+	for (size_t i = 0; i < numprops; i++)
+	{
+		CProperty tmp(nullptr);
+
+		if (!r.ReadRaw(&tmp.m_ID, sizeof(FOURCHARCODE)) || !tmp.DeserializeCompact(r))
+			return false;
+
+		size_t idx = m_pSchema->FindById(tmp.m_ID);
+
+		if (tmp.m_Type == IProperty::PT_BOOLEAN)
+		{
+			bools.push_back(idx);
+		}
+		else if (idx != (size_t)-1)
+		{
+			Proxy(idx)->Store(tmp);
+			m_Stamps[idx] = ++m_Stamp;
+		}
+	}
+
+	if (!r.BeginBools(bools.size()))
+		return false;
+
+	for (size_t i = 0, maxi = bools.size(); i < maxi; i++)
+	{
+		if (bools[i] == (size_t)-1)
+			continue;
+
+		CProperty tmp(nullptr);
+		tmp.SetBool(r.ReadBool(i));
+
+		Proxy(bools[i])->Store(tmp);
+		m_Stamps[bools[i]] = ++m_Stamp;
+	}
+
+	if (bytesconsumed)
+		*bytesconsumed = r.GetConsumed();
+
+	return true;
+}
+
+bool CSchemaPropertySet::DeserializeAligned(BYTE *buf, size_t bufsize, size_t *bytesconsumed)
+{
+	CAlignedReader r(buf, bufsize);
+
+	size_t numprops;
+	if (!r.BeginSet(&numprops))
+		return false;
+
+	for (size_t i = 0; i < numprops; i++)
+	{
+		CProperty tmp(nullptr);
+
+		if (!r.ReadAligned(&tmp.m_ID, sizeof(FOURCHARCODE), sizeof(FOURCHARCODE)) || !tmp.DeserializeAligned(r))
+			return false;
+
+		size_t idx = m_pSchema->FindById(tmp.m_ID);
+		if (idx != (size_t)-1)
+		{
+			Proxy(idx)->Store(tmp);
+			m_Stamps[idx] = ++m_Stamp;
+		}
+	}
+
+	if (bytesconsumed)
+		*bytesconsumed = r.GetConsumed();
+
+	return true;
+}
+
+void CSchemaPropertySet::StoreString(uint8_t *slot, const TCHAR *s)
+{
+	TCHAR **ps = (TCHAR **)slot;
+	if (*ps && s && !_tcscmp(*ps, s))
+		return;
+
+	free(*ps);
+	*ps = s ? _tcsdup(s) : nullptr;
+}
+
+
+// Columnar tables: each schema property's values for every row are kept in one contiguous array, and any row can be
+// viewed as a schema-backed property set whose slots point into those arrays
+
+class CPropertyTable : public IPropertyTable
+{
+public:
+	CPropertySchema *m_pSchema;
+
+	// one array of values per schema property, indexed by row
+	typedef ::std::vector<uint8_t> TColumn;
+	typedef ::std::vector<TColumn> TColumnArray;
+	TColumnArray m_Columns;
+
+	// the size of one value in each column
+	typedef ::std::vector<size_t> TStrideArray;
+	TStrideArray m_Strides;
+
+	size_t m_Rows;
+
+	// one for the creator plus one for each row view
+	::std::atomic<size_t> m_Refs;
+
+	CPropertyTable(CPropertySchema *pschema);
+	virtual ~CPropertyTable();
+
+	void AddRef() { m_Refs++; }
+
+	virtual void Release();
+	virtual size_t GetRowCount() const;
+	virtual size_t AddRows(size_t count);
+	virtual void RemoveRow(size_t row);
+	virtual void RemoveAllRows();
+	virtual IPropertySet *CreateRowView(size_t row);
+	virtual void *GetColumn(FOURCHARCODE propid, IProperty::PROPERTY_TYPE *type);
+
+	// string columns own the strings their values point at
+	bool IsStringColumn(size_t col) const
+	{
+		return (m_pSchema->m_Protos[col]->m_Type == IProperty::PT_STRING);
+	}
+};
+
+
+// a property set over one row of a table
+class CPropertyRowView : public CSchemaPropertySet
+{
+public:
+	CPropertyTable *m_pTable;
+	size_t m_Row;
+
+	CPropertyRowView(CPropertyTable *ptable, size_t row) : CSchemaPropertySet(ptable->m_pSchema, false)
+	{
+		m_pTable = ptable;
+		m_pTable->AddRef();
+		m_Row = row;
+	}
+
+	virtual ~CPropertyRowView()
+	{
+		m_pTable->Release();
+	}
+
+	virtual uint8_t *SlotAddress(size_t idx) const
+	{
+		return m_pTable->m_Columns[idx].data() + (m_Row * m_pTable->m_Strides[idx]);
+	}
+
+	virtual bool HasValues() const
+	{
+		return (m_Row < m_pTable->m_Rows);
+	}
+};
+
+
+CPropertyTable::CPropertyTable(CPropertySchema *pschema)
+{
+	m_Refs = 1;
+	m_Rows = 0;
+
+	m_pSchema = pschema;
+	m_pSchema->AddRef();
+
+	size_t n = m_pSchema->m_Protos.size();
+	m_Columns.resize(n);
+	m_Strides.resize(n);
+	for (size_t i = 0; i < n; i++)
+		m_Strides[i] = CPropertySchema::ValueSize(m_pSchema->m_Protos[i]->m_Type);
+}
+
+CPropertyTable::~CPropertyTable()
+{
+	RemoveAllRows();
+
+	m_pSchema->Release();
+}
+
+void CPropertyTable::Release()
+{
+	if (!--m_Refs)
+		delete this;
+}
+
+size_t CPropertyTable::GetRowCount() const
+{
+	return m_Rows;
+}
+
+size_t CPropertyTable::AddRows(size_t count)
+{
+	size_t first = m_Rows;
+
+	for (size_t c = 0, maxc = m_Columns.size(); c < maxc; c++)
+	{
+		size_t stride = m_Strides[c];
+		const uint8_t *def = m_pSchema->m_pDefaults + m_pSchema->m_Offsets[c];
+		bool strings = IsStringColumn(c);
+
+		TColumn &col = m_Columns[c];
+		col.resize((m_Rows + count) * stride);
+
+		for (size_t r = m_Rows; r < (m_Rows + count); r++)
+		{
+			uint8_t *slot = col.data() + (r * stride);
+			memcpy(slot, def, stride);
+
+			// the defaults only point at the prototypes' strings; each row needs its own copy
+			if (strings && *((TCHAR **)slot))
+				*((TCHAR **)slot) = _tcsdup(*((TCHAR **)slot));
+		}
+	}
+
+	m_Rows += count;
+
+	return first;
+}
+
+void CPropertyTable::RemoveRow(size_t row)
+{
+	if (row >= m_Rows)
+		return;
+
+	size_t last = m_Rows - 1;
+
+	for (size_t c = 0, maxc = m_Columns.size(); c < maxc; c++)
+	{
+		size_t stride = m_Strides[c];
+		TColumn &col = m_Columns[c];
+		uint8_t *slot = col.data() + (row * stride);
+
+		if (IsStringColumn(c))
+			free(*((TCHAR **)slot));
+
+		// the last row's string, if any, now belongs to the moved row
+		if (row != last)
+			memcpy(slot, col.data() + (last * stride), stride);
+
+		col.resize(last * stride);
+	}
+
+	m_Rows = last;
+}
+
+void CPropertyTable::RemoveAllRows()
+{
+	for (size_t c = 0, maxc = m_Columns.size(); c < maxc; c++)
+	{
+		TColumn &col = m_Columns[c];
+
+		if (IsStringColumn(c))
+		{
+			for (size_t r = 0; r < m_Rows; r++)
+				free(*((TCHAR **)(col.data() + (r * m_Strides[c]))));
+		}
+
+		col.clear();
+	}
+
+	m_Rows = 0;
+}
+
+IPropertySet *CPropertyTable::CreateRowView(size_t row)
+{
+	if (row >= m_Rows)
+		return nullptr;
+
+	return new CPropertyRowView(this, row);
+}
+
+void *CPropertyTable::GetColumn(FOURCHARCODE propid, IProperty::PROPERTY_TYPE *type)
+{
+	size_t idx = m_pSchema->FindById(propid);
+	if (idx == (size_t)-1)
+		return nullptr;
+
+	if (type)
+		*type = m_pSchema->m_Protos[idx]->m_Type;
+
+	return m_Columns[idx].data();
+}
+
+
+// Views over serialized sets: the records are validated and indexed once, then every value is read straight out of the
+// caller's buffer
+
+bool CProperty::DeserializeValue(const BYTE *&buf, const BYTE *end)
+{
+	if (m_Type == PT_STRING)
+	{
+		for (const BYTE *s = buf; (s + sizeof(TCHAR)) <= end; s += sizeof(TCHAR))
+		{
+			TCHAR c;
+			memcpy(&c, s, sizeof(TCHAR));
+			if (!c)
+			{
+				StoreString((const TCHAR *)buf);
+				buf = s + sizeof(TCHAR);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// SerializeValue writes nothing for an untyped property
+	if (m_Type == PT_NONE)
+		return true;
+
+	size_t sz = CPropertySchema::ValueSize(m_Type);
+	if ((m_Type >= PT_NUMTYPES) || (size_t(end - buf) < sz))
+		return false;
+
+	memcpy(ValueAddress(), buf, sz);
+	buf += sz;
+
+	return true;
+}
+
+
+class CPropertySetView : public IPropertySetView
+{
+public:
+	struct SRecord
+	{
+		const uint8_t *m_pValue;		// for PT_ENUM, the current value; the strings are at m_pStr
+		const TCHAR *m_pStr;			// the value of a PT_STRING, or a PT_ENUM's strings
+		const TCHAR *m_pName;			// only written in SM_BIN_VERBOSE
+		FOURCHARCODE m_ID;
+		IProperty::PROPERTY_TYPE m_Type;
+		IProperty::PROPERTY_ASPECT m_Aspect;
+	};
+
+	typedef ::std::vector<SRecord> TRecordArray;
+	TRecordArray m_Records;
+
+	// fills m_Records, failing if the buffer is truncated or contains anything Serialize wouldn't have written
+	bool Parse(const uint8_t *buf, size_t bufsize, size_t *bytesconsumed);
+
+	// parses the record at p and advances p past it, with the same checks as Parse
+	static bool ParseRecord(const uint8_t *&p, const uint8_t *end, SRecord &r);
+
+	// fills m_Records from a SM_BIN_ALIGNED set; Parse hands these off
+	bool ParseAligned(const uint8_t *buf, size_t bufsize, size_t *bytesconsumed);
+
+	// copies out the record at idx; archive views parse it from the buffer on request instead
+	virtual bool GetRecord(size_t idx, SRecord &r) const
+	{
+		if (idx >= m_Records.size())
+			return false;
+
+		r = m_Records[idx];
+		return true;
+	}
+
+	// the size of the string at p, including its terminator, or 0 if it isn't terminated before end
+	static size_t StringSize(const uint8_t *p, const uint8_t *end)
+	{
+		for (const uint8_t *s = p; (s + sizeof(TCHAR)) <= end; s += sizeof(TCHAR))
+		{
+			TCHAR c;
+			memcpy(&c, s, sizeof(TCHAR));
+			if (!c)
+				return (s - p) + sizeof(TCHAR);
+		}
+
+		return 0;
+	}
+
+	// gets the record at idx if it holds the given type
+	bool Record(size_t idx, IProperty::PROPERTY_TYPE type, SRecord &r) const
+	{
+		return GetRecord(idx, r) && (r.m_Type == type);
+	}
+
+	template <typename T> T Scalar(size_t idx, IProperty::PROPERTY_TYPE type) const
+	{
+		T ret = T(0);
+
+		SRecord r;
+		if (Record(idx, type, r))
+			memcpy(&ret, r.m_pValue, sizeof(T));
+
+		return ret;
+	}
+
+	template <typename T> const T *Pointer(size_t idx, IProperty::PROPERTY_TYPE type) const
+	{
+		SRecord r;
+		return Record(idx, type, r) ? (const T *)r.m_pValue : nullptr;
+	}
+
+	virtual ~CPropertySetView() { }
+
+	virtual void Release()
+	{
+		delete this;
+	}
+
+	virtual size_t GetPropertyCount() const
+	{
+		return m_Records.size();
+	}
+
+	virtual size_t FindById(FOURCHARCODE propid) const
+	{
+		for (size_t i = 0, maxi = m_Records.size(); i < maxi; i++)
+		{
+			if (m_Records[i].m_ID == propid)
+				return i;
+		}
+
+		return (size_t)-1;
+	}
+
+	virtual size_t FindByName(const TCHAR *propname) const
+	{
+		if (!propname)
+			return (size_t)-1;
+
+		for (size_t i = 0, maxi = m_Records.size(); i < maxi; i++)
+		{
+			if (m_Records[i].m_pName && !_tcsicmp(m_Records[i].m_pName, propname))
+				return i;
+		}
+
+		return (size_t)-1;
+	}
+
+	virtual FOURCHARCODE GetID(size_t idx) const
+	{
+		return (idx < m_Records.size()) ? m_Records[idx].m_ID : 0;
+	}
+
+	virtual const TCHAR *GetName(size_t idx) const
+	{
+		return (idx < m_Records.size()) ? m_Records[idx].m_pName : nullptr;
+	}
+
+	virtual IProperty::PROPERTY_TYPE GetType(size_t idx) const
+	{
+		return (idx < m_Records.size()) ? m_Records[idx].m_Type : IProperty::PT_NONE;
+	}
+
+	virtual IProperty::PROPERTY_ASPECT GetAspect(size_t idx) const
+	{
+		return (idx < m_Records.size()) ? m_Records[idx].m_Aspect : IProperty::PA_GENERIC;
+	}
+
+	virtual int64_t AsInt(size_t idx) const
+	{
+		if (GetType(idx) == IProperty::PT_ENUM)
+			return (int64_t)Scalar<uint64_t>(idx, IProperty::PT_ENUM);
+
+		return Scalar<int64_t>(idx, IProperty::PT_INT);
+	}
+
+	virtual const TVec2I *AsVec2I(size_t idx) const
+	{
+		return Pointer<TVec2I>(idx, IProperty::PT_INT_V2);
+	}
+
+	virtual const TVec3I *AsVec3I(size_t idx) const
+	{
+		return Pointer<TVec3I>(idx, IProperty::PT_INT_V3);
+	}
+
+	virtual const TVec4I *AsVec4I(size_t idx) const
+	{
+		return Pointer<TVec4I>(idx, IProperty::PT_INT_V4);
+	}
+
+	virtual float AsFloat(size_t idx) const
+	{
+		return Scalar<float>(idx, IProperty::PT_FLOAT);
+	}
+
+	virtual const TVec2F *AsVec2F(size_t idx) const
+	{
+		return Pointer<TVec2F>(idx, IProperty::PT_FLOAT_V2);
+	}
+
+	virtual const TVec3F *AsVec3F(size_t idx) const
+	{
+		return Pointer<TVec3F>(idx, IProperty::PT_FLOAT_V3);
+	}
+
+	virtual const TVec4F *AsVec4F(size_t idx) const
+	{
+		return Pointer<TVec4F>(idx, IProperty::PT_FLOAT_V4);
+	}
+
+	virtual const TCHAR *AsString(size_t idx) const
+	{
+		SRecord r;
+		return Record(idx, IProperty::PT_STRING, r) ? r.m_pStr : nullptr;
+	}
+
+	virtual const GUID *AsGUID(size_t idx) const
+	{
+		return Pointer<GUID>(idx, IProperty::PT_GUID);
+	}
+
+	virtual bool AsBool(size_t idx) const
+	{
+		return Scalar<bool>(idx, IProperty::PT_BOOLEAN);
+	}
+
+	virtual const TMat3x3F *AsMat3x3F(size_t idx) const
+	{
+		return Pointer<TMat3x3F>(idx, IProperty::PT_FLOAT_MAT3X3);
+	}
+
+	virtual const TMat4x4F *AsMat4x4F(size_t idx) const
+	{
+		return Pointer<TMat4x4F>(idx, IProperty::PT_FLOAT_MAT4X4);
+	}
+
+	virtual const TCHAR *GetEnumStrings(size_t idx) const
+	{
+		SRecord r;
+		return Record(idx, IProperty::PT_ENUM, r) ? r.m_pStr : nullptr;
+	}
+};
+
+
+// a view of an archive written by SerializeArchive; the index answers lookups and records are parsed as they're read
+class CPropertyArchiveView : public CPropertySetView
+{
+public:
+	const uint8_t *m_pBuf;
+	const SArchiveEntry *m_pIndex;
+	size_t m_Count;
+
+	// set when OpenPropertyArchive mapped the buffer
+	HANDLE m_hFile, m_hMapping;
+
+	CPropertyArchiveView()
+	{
+		m_pBuf = nullptr;
+		m_pIndex = nullptr;
+		m_Count = 0;
+		m_hFile = INVALID_HANDLE_VALUE;
+		m_hMapping = NULL;
+	}
+
+	virtual ~CPropertyArchiveView()
+	{
+		if (m_hMapping)
+		{
+			UnmapViewOfFile(m_pBuf);
+			CloseHandle(m_hMapping);
+		}
+
+		if (m_hFile != INVALID_HANDLE_VALUE)
+			CloseHandle(m_hFile);
+	}
+
+	// checks the header and index, but none of the records
+	bool Open(const uint8_t *buf, size_t bufsize)
+	{
+		SArchiveHeader hdr;
+		if (!buf || (bufsize < sizeof(SArchiveHeader)))
+			return false;
+
+		memcpy(&hdr, buf, sizeof(SArchiveHeader));
+		if ((hdr.m_Magic != ARCHIVE_MAGIC) || (hdr.m_Version != ARCHIVE_VERSION) || (hdr.m_EntrySize != sizeof(SArchiveEntry)))
+			return false;
+
+		if (((bufsize - sizeof(SArchiveHeader)) / sizeof(SArchiveEntry)) < hdr.m_Count)
+			return false;
+
+		m_pBuf = buf;
+		m_pIndex = (const SArchiveEntry *)(buf + sizeof(SArchiveHeader));
+		m_Count = hdr.m_Count;
+
+		for (size_t i = 0; i < m_Count; i++)
+		{
+			const SArchiveEntry &e = m_pIndex[i];
+			if ((e.m_Offset > bufsize) || (e.m_Size > (bufsize - e.m_Offset)) || (e.m_Type >= IProperty::PT_NUMTYPES))
+				return false;
+
+			// FindById relies on the ids being sorted and unique
+			if (i && (m_pIndex[i - 1].m_ID >= e.m_ID))
+				return false;
+		}
+
+		return true;
+	}
+
+	virtual bool GetRecord(size_t idx, SRecord &r) const
+	{
+		if (idx >= m_Count)
+			return false;
+
+		const SArchiveEntry &e = m_pIndex[idx];
+		const uint8_t *p = m_pBuf + e.m_Offset, *end = p + e.m_Size;
+
+		return ParseRecord(p, end, r) && (r.m_ID == e.m_ID) && (r.m_Type == IProperty::PROPERTY_TYPE(e.m_Type));
+	}
+
+	virtual void Release()
+	{
+		delete this;
+	}
+
+	virtual size_t GetPropertyCount() const
+	{
+		return m_Count;
+	}
+
+	virtual size_t FindById(FOURCHARCODE propid) const
+	{
+		const SArchiveEntry *last = m_pIndex + m_Count;
+		const SArchiveEntry *e = ::std::lower_bound(m_pIndex, last, propid, [](const SArchiveEntry &a, FOURCHARCODE id) { return a.m_ID < id; });
+
+		return ((e != last) && (e->m_ID == propid)) ? size_t(e - m_pIndex) : (size_t)-1;
+	}
+
+	virtual size_t FindByName(const TCHAR *propname) const
+	{
+		if (!propname)
+			return (size_t)-1;
+
+		SRecord r;
+		for (size_t i = 0; i < m_Count; i++)
+		{
+			if (GetRecord(i, r) && r.m_pName && !_tcsicmp(r.m_pName, propname))
+				return i;
+		}
+
+		return (size_t)-1;
+	}
+
+	virtual FOURCHARCODE GetID(size_t idx) const
+	{
+		return (idx < m_Count) ? m_pIndex[idx].m_ID : 0;
+	}
+
+	virtual const TCHAR *GetName(size_t idx) const
+	{
+		SRecord r;
+		return GetRecord(idx, r) ? r.m_pName : nullptr;
+	}
+
+	virtual IProperty::PROPERTY_TYPE GetType(size_t idx) const
+	{
+		return (idx < m_Count) ? IProperty::PROPERTY_TYPE(m_pIndex[idx].m_Type) : IProperty::PT_NONE;
+	}
+
+	virtual IProperty::PROPERTY_ASPECT GetAspect(size_t idx) const
+	{
+		return (idx < m_Count) ? IProperty::PROPERTY_ASPECT(m_pIndex[idx].m_Aspect) : IProperty::PA_GENERIC;
+	}
+};
+
+
+void CProperty::SerializeAligned(CAlignedWriter &w) const
+{
+	w.WriteAligned(&m_ID, sizeof(FOURCHARCODE), sizeof(FOURCHARCODE));
+	w.WriteByte(BYTE(m_Type));
+	w.WriteByte(BYTE(m_Aspect));
+
+	switch (m_Type)
+	{
+		case PT_NONE:
+			break;
+
+		case PT_STRING:
+			w.WriteString(Str());
+			break;
+
+		case PT_ENUM:
+			w.WriteString(m_s);
+			w.WriteAligned(&m_e, sizeof(uint64_t), sizeof(uint64_t));
+			break;
+
+		default:
+			w.WriteAligned(ValueAddress(), CPropertySchema::ValueSize(m_Type), CPropertySchema::ValueAlignment(m_Type));
+			break;
+	}
+}
+
+bool CProperty::DeserializeAligned(CAlignedReader &r)
+{
+	Reset();
+
+	BYTE type = r.ReadByte();
+	BYTE aspect = r.ReadByte();
+
+	if (!r.OK() || (type >= PT_NUMTYPES) || (aspect >= PA_NUMASPECTS))
+		return false;
+
+	m_Type = PROPERTY_TYPE(type);
+	m_Aspect = PROPERTY_ASPECT(aspect);
+
+	switch (m_Type)
+	{
+		case PT_NONE:
+			break;
+
+		case PT_STRING:
+		{
+			const TCHAR *s = r.ReadString();
+			if (!s)
+				return false;
+
+			StoreString(s);
+			break;
+		}
+
+		case PT_ENUM:
+		{
+			const TCHAR *strs = r.ReadString();
+			if (!strs)
+				return false;
+
+			// not SetEnumStrings, which would Reset again and free what the old type left in m_s
+			if (!m_Flags.IsSet(PROPFLAG_ENUMPROVIDER))
+				StoreEnumStrings(*strs ? strs : nullptr);
+
+			r.ReadAligned(&m_e, sizeof(uint64_t), sizeof(uint64_t));
+			break;
+		}
+
+		default:
+			r.ReadAligned(ValueAddress(), CPropertySchema::ValueSize(m_Type), CPropertySchema::ValueAlignment(m_Type));
+			break;
+	}
+
+	return r.OK();
+}
+
+
+// SerializeBatch writes a short of -3, the mode as a byte, then 32-bit counts of sets and properties. Each property follows
+// as the first set's record for it, in the given mode, then the property's values in every set, written by SerializeValue
+class CBatchSerializer
+{
+protected:
+	// gets at any set's property as a CProperty; schema properties are copied
+	static bool WriteRecord(const IProperty *pprop, IProperty::SERIALIZE_MODE mode, IDataSink *psink)
+	{
+		if (CProperty::IsSchemaProperty(pprop))
+		{
+			CSchemaPropertyCopy c((const CSchemaProperty *)pprop);
+			return c.Serialize(mode, psink);
+		}
+
+		return ((const CProperty *)pprop)->Serialize(mode, psink);
+	}
+
+	static bool WriteValue(const IProperty *pprop, IDataSink *psink)
+	{
+		if (CProperty::IsSchemaProperty(pprop))
+		{
+			CSchemaPropertyCopy c((const CSchemaProperty *)pprop);
+			return c.SerializeValue(psink);
+		}
+
+		return ((const CProperty *)pprop)->SerializeValue(psink);
+	}
+
+public:
+	static bool Write(const IPropertySet * const *sets, size_t numsets, IProperty::SERIALIZE_MODE mode, IDataSink *psink)
+	{
+		if (!sets || !numsets || !sets[0] || !psink || (mode > IProperty::SM_BIN_VERBOSE) || (numsets > UINT32_MAX))
+			return false;
+
+		size_t numprops = sets[0]->GetPropertyCount();
+
+		// find every set's properties up front, column by column, so nothing is written for a batch that doesn't match
+		::std::vector<const IProperty *> cols(numprops * numsets);
+		for (size_t i = 0; i < numprops; i++)
+		{
+			const IProperty *p0 = sets[0]->GetProperty(i);
+			if (!p0)
+				return false;
+
+			for (size_t j = 0; j < numsets; j++)
 			{
-				if (isalnum(c))
-				{
-					idtemp += c;
-				}
-				else
-				{
-					idtemp += _T("&#");
-					TCHAR num[8];
-					_itot_s(c, num, 10);
-					idtemp += num;
-					idtemp += _T(";");
-				}
+				const IProperty *p = j ? (sets[j] ? sets[j]->GetPropertyById(p0->GetID()) : nullptr) : p0;
+				if (!p || (p->GetType() != p0->GetType()) || (sets[j]->GetPropertyCount() != numprops))
+					return false;
+
+				cols[(i * numsets) + j] = p;
+			}
+		}
+
+		short marker = -3;
+		BYTE m = BYTE(mode);
+		uint32_t ns = uint32_t(numsets), np = uint32_t(numprops);
+		if (!psink->Write(&marker, sizeof(short)) || !psink->Write(&m, sizeof(BYTE)) || !psink->Write(&ns, sizeof(uint32_t)) || !psink->Write(&np, sizeof(uint32_t)))
+			return false;
+
+		for (size_t i = 0; i < numprops; i++)
+		{
+			const IProperty * const *col = &cols[i * numsets];
+
+			if (!WriteRecord(col[0], mode, psink))
+				return false;
+
+			for (size_t j = 0; j < numsets; j++)
+			{
+				if (!WriteValue(col[j], psink))
+					return false;
 			}
 		}
-		xmls += idtemp;
-		xmls += _T("\"");
 
-		if (mode > props::IProperty::SERIALIZE_MODE::SM_BIN_TERSE)
-		{
-			xmls += _T(" name=\"");
-			tstring _name = it->second->GetName(), name;
-			props::EscapeString(_name.c_str(), name);
-			xmls += name;
-			xmls += _T("\"");
-		}
+		return true;
+	}
 
-		xmls += _T(" type=\"");
-		switch (it->second->GetType())
+	static bool Read(const uint8_t *buf, size_t bufsize, IPropertySet **sets, size_t maxsets, size_t *numsets, size_t *bytesconsumed)
+	{
+		const size_t hdrsize = sizeof(short) + sizeof(BYTE) + (sizeof(uint32_t) * 2);
+		if (!buf || (bufsize < hdrsize))
+			return false;
+
+		short marker;
+		memcpy(&marker, buf, sizeof(short));
+		if ((marker != -3) || (buf[sizeof(short)] > IProperty::SM_BIN_VERBOSE))
+			return false;
+
+		uint32_t ns, np;
+		memcpy(&ns, buf + sizeof(short) + sizeof(BYTE), sizeof(uint32_t));
+		memcpy(&np, buf + sizeof(short) + sizeof(BYTE) + sizeof(uint32_t), sizeof(uint32_t));
+
+		if (numsets)
+			*numsets = ns;
+
+		if (!sets || (maxsets < ns))
+			return false;
+
+		for (size_t j = 0; j < ns; j++)
 		{
-			case props::IProperty::PROPERTY_TYPE::PT_BOOLEAN:
-				xmls += _T("BOOLEAN");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_ENUM:
-				xmls += _T("ENUM");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_FLOAT:
-				xmls += _T("FLOAT");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V2:
-				xmls += _T("FLOAT_V2");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V3:
-				xmls += _T("FLOAT_V3");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V4:
-				xmls += _T("FLOAT_V4");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_GUID:
-				xmls += _T("GUID");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_INT:
-				xmls += _T("INT");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_INT_V2:
-				xmls += _T("INT_V2");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_INT_V3:
-				xmls += _T("INT_V3");
-				break;
-			case props::IProperty::PROPERTY_TYPE::PT_INT_V4:
-				xmls += _T("INT_V4");
-				break;
-			default:
-			case props::IProperty::PROPERTY_TYPE::PT_STRING:
-				xmls += _T("STRING");
-				break;
+			if (!sets[j])
+				sets[j] = IPropertySet::CreatePropertySet();
 		}
-		xmls += _T("\"");
 
-		if ((mode >= props::IProperty::SERIALIZE_MODE::SM_BIN_TERSE) && (it->second->GetAspect() != props::IProperty::PROPERTY_ASPECT::PA_GENERIC))
+		const BYTE *p = buf + hdrsize, *end = buf + bufsize;
+
+		for (uint32_t i = 0; i < np; i++)
 		{
-			xmls += _T(" aspect=\"");
-			switch (it->second->GetAspect())
+			// the record gives the column's id, type, aspect, name and enum strings; only its value changes from set to set.
+			// CProperty::Deserialize trusts its buffer, so check the record first
+			const BYTE *next = p;
+			CPropertySetView::SRecord r;
+			if (!CPropertySetView::ParseRecord(next, end, r))
+				return false;
+
+			CProperty proto(nullptr);
+			if (!proto.Deserialize((BYTE *)p, size_t(next - p), nullptr))
+				return false;
+			p = next;
+
+			for (size_t j = 0; j < ns; j++)
 			{
-				case props::IProperty::PROPERTY_ASPECT::PA_BOOL_ONOFF:
-					xmls += _T("BOOL_ONOFF");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_BOOL_YESNO:
-					xmls += _T("BOOL_YESNO");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_COLOR_RGB:
-					xmls += _T("COLOR_RGB");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_COLOR_RGBA:
-					xmls += _T("COLOR_RGBA");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_DATE:
-					xmls += _T("DATE");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_DIRECTORY:
-					xmls += _T("DIRECTORY");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_ELEVAZIM:
-					xmls += _T("ELEVAZIM");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_FILENAME:
-					xmls += _T("FILENAME");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_FONT_DESC:
-					xmls += _T("FONT_DESC");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_IPADDRESS:
-					xmls += _T("IP_ADDRESS");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_LATLON:
-					xmls += _T("LATLON");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_QUATERNION:
-					xmls += _T("QUATERNION");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_RASCDEC:
-					xmls += _T("RASCDEC");
-					break;
-				case props::IProperty::PROPERTY_ASPECT::PA_TIME:
-					xmls += _T("TIME");
-					break;
-				default:
-					TCHAR t[16];
-					_itot_s((int)(it->second->GetAspect()), t, 10);
-					xmls += t;
-					break;
+				if (!proto.DeserializeValue(p, end))
+					return false;
+
+				IProperty *pp = sets[j]->GetPropertyById(proto.GetID());
+				if (!pp)
+					pp = sets[j]->CreateProperty(proto.GetName(), proto.GetID());
+
+				if (pp)
+					pp->SetFromProperty(&proto, false);
 			}
-			xmls += _T("\"");
 		}
 
-		xmls += _T(">");
+		if (bytesconsumed)
+			*bytesconsumed = size_t(p - buf);
+
+		return true;
+	}
+};
+
+
+// SerializeMulti writes a short of -4 and a 32-bit set count, then numsets + 1 64-bit offsets from the start of the
+// archive, where each set begins and the last one ends, and then the sets themselves
+class CMultiSetSerializer
+{
+public:
+	static bool Write(const IPropertySet * const *sets, size_t numsets, IProperty::SERIALIZE_MODE mode, IDataSink *psink)
+	{
+		if (!sets || !psink || (numsets > UINT32_MAX))
+			return false;
 
-		TCHAR _q[1 << 12];
-		TCHAR _s[1 << 17];
-		_s[0] = _T('\0');
+		size_t hdrsize = sizeof(short) + sizeof(uint32_t) + ((numsets + 1) * sizeof(uint64_t));
 
-		if (it->second->GetType() != props::IProperty::PROPERTY_TYPE::PT_ENUM)
+		// measure every set first, so the table can go ahead of them and they can be streamed out directly
+		::std::vector<uint64_t> offsets(numsets + 1);
+		offsets[0] = hdrsize;
+		for (size_t i = 0; i < numsets; i++)
 		{
-			it->second->AsString(_s, _countof(_s));
+			CFixedDataSink measure(nullptr, 0);
+			if (!sets[i] || !sets[i]->Serialize(mode, &measure))
+				return false;
+
+			offsets[i + 1] = offsets[i] + measure.GetSize();
 		}
-		else
+
+		short marker = -4;
+		uint32_t ns = uint32_t(numsets);
+		if (!psink->Write(&marker, sizeof(short)) || !psink->Write(&ns, sizeof(uint32_t)) || !psink->Write(offsets.data(), offsets.size() * sizeof(uint64_t)))
+			return false;
+
+		for (size_t i = 0; i < numsets; i++)
+		{
+			if (!sets[i]->Serialize(mode, psink))
+				return false;
+		}
+
+		return true;
+	}
+
+	static bool Read(const uint8_t *buf, size_t bufsize, IPropertySet **sets, size_t maxsets, size_t *numsets, size_t numthreads, size_t *bytesconsumed)
+	{
+		if (!buf || (bufsize < (sizeof(short) + sizeof(uint32_t))))
+			return false;
+
+		short marker;
+		uint32_t ns;
+		memcpy(&marker, buf, sizeof(short));
+		memcpy(&ns, buf + sizeof(short), sizeof(uint32_t));
+		if (marker != -4)
+			return false;
+
+		if (numsets)
+			*numsets = ns;
+
+		if (!sets || (maxsets < ns))
+			return false;
+
+		size_t tablepos = sizeof(short) + sizeof(uint32_t);
+		if (((bufsize - tablepos) / sizeof(uint64_t)) <= ns)
+			return false;
+
+		// every set has to lie inside the buffer, after the table and in order, before any thread touches one
+		::std::vector<uint64_t> offsets(ns + 1);
+		memcpy(offsets.data(), buf + tablepos, offsets.size() * sizeof(uint64_t));
+		if ((offsets[0] != (tablepos + (offsets.size() * sizeof(uint64_t)))) || (offsets[ns] > bufsize))
+			return false;
+
+		for (size_t i = 0; i < ns; i++)
+		{
+			if (offsets[i + 1] <= offsets[i])
+				return false;
+		}
+
+		// workers claim sets one at a time, so uneven sets still spread evenly
+		::std::atomic<size_t> next(0);
+		::std::atomic<bool> ok(true);
+
+		auto work = [&]()
 		{
-			TCHAR *q = _q;
-			for (size_t i = 0; i < it->second->GetMaxEnumVal(); i++)
+			for (size_t i = next++; (i < ns) && ok; i = next++)
 			{
-				it->second->GetEnumString(i, q, _countof(_q));
-				_tcscat_s(_s, _q);
-				if (i < (it->second->GetMaxEnumVal() - 1))
-					_tcscat_s(_s, _T(","));
+				if (!sets[i])
+					sets[i] = IPropertySet::CreatePropertySet();
+
+				size_t sz = size_t(offsets[i + 1] - offsets[i]), used = 0;
+				if (!sets[i]->Deserialize((BYTE *)buf + offsets[i], sz, &used) || (used != sz))
+					ok = false;
 			}
-			TCHAR num[16];
-			_i64tot_s(it->second->AsInt(), num, _countof(num), 10);
-			_tcscat_s(_s, _T(":"));
-			_tcscat_s(_s, num);
-		}
+		};
 
-		tstring s;
-		props::EscapeString(_s, s);
-		xmls += s;
+		if (!numthreads)
+			numthreads = ::std::max<size_t>(::std::thread::hardware_concurrency(), 1);
+		numthreads = ::std::min<size_t>(numthreads, ns);
 
-		xmls += _T("</powerprops:property>\n");
+		// the calling thread does its share too
+		::std::vector<::std::thread> workers;
+		for (size_t t = 1; t < numthreads; t++)
+			workers.emplace_back(work);
+
+		work();
+
+		for (::std::thread &w : workers)
+			w.join();
+
+		if (bytesconsumed)
+			*bytesconsumed = size_t(offsets[ns]);
+
+		return ok;
 	}
+};
 
-	xmls += _T("</powerprops:property_set>");
+
+bool CPropertySetView::Parse(const uint8_t *buf, size_t bufsize, size_t *bytesconsumed)
+{
+	if (!buf || (bufsize < sizeof(short)))
+		return false;
+
+	if (CAlignedReader::IsAlignedSet(buf, bufsize))
+		return ParseAligned(buf, bufsize, bytesconsumed);
+
+	const uint8_t *p = buf, *end = buf + bufsize;
+
+	short numprops;
+	memcpy(&numprops, p, sizeof(short));
+	p += sizeof(short);
+
+	if (numprops < 0)
+		return false;
+
+	m_Records.resize(numprops);
+
+	for (short i = 0; i < numprops; i++)
+	{
+		if (!ParseRecord(p, end, m_Records[i]))
+			return false;
+	}
+
+	if (bytesconsumed)
+		*bytesconsumed = p - buf;
 
 	return true;
 }
 
-bool CPropertySet::DeserializeFromXMLString(const tstring &xmls)
+
+bool CPropertySetView::ParseAligned(const uint8_t *buf, size_t bufsize, size_t *bytesconsumed)
 {
-	bool ret = false;
+	CAlignedReader rd(buf, bufsize);
+
+	size_t numprops;
+	if (!rd.BeginSet(&numprops) || (numprops > (bufsize / (sizeof(FOURCHARCODE) + (sizeof(BYTE) * 2)))))
+		return false;
 
-	genio::IParserT *p = (genio::IParserT *)genio::IParser::Create(genio::IParser::CHAR_MODE::CM_TCHAR), *q = nullptr;
-	p->SetSourceData(xmls.c_str(), xmls.length());
+	m_Records.resize(numprops);
 
-	while (p->NextToken())
+	for (size_t i = 0; i < numprops; i++)
 	{
-		if (p->IsToken(_T("<")))
+		SRecord &r = m_Records[i];
+
+		rd.ReadAligned(&r.m_ID, sizeof(FOURCHARCODE), sizeof(FOURCHARCODE));
+		r.m_Type = IProperty::PROPERTY_TYPE(rd.ReadByte());
+		r.m_Aspect = IProperty::PROPERTY_ASPECT(rd.ReadByte());
+		r.m_pName = nullptr;
+		r.m_pStr = nullptr;
+
+		if (!rd.OK() || (r.m_Type >= IProperty::PT_NUMTYPES))
+			return false;
+
+		// values are used where they lie, so nothing is copied
+		size_t sz;
+		switch (r.m_Type)
 		{
-			p->NextToken();
+			case IProperty::PT_STRING:
+				r.m_pStr = (const TCHAR *)rd.TakeString(&sz);
+				r.m_pValue = (const uint8_t *)r.m_pStr;
+				break;
 
-			// skip end tags and comments
-			if (p->IsToken(_T("/")) || p->IsToken(_T("!")))
-			{
-				p->ReadUntil(_T(">"), false, true);
-				continue;
-			}
+			case IProperty::PT_ENUM:
+				r.m_pStr = (const TCHAR *)rd.TakeString(&sz);
+				r.m_pValue = rd.Take(sizeof(uint64_t), sizeof(uint64_t));
+				break;
 
-			// make sure the tags are pre-pended with "powerprops"
-			if (p->IsToken(_T("powerprops")))
-			{
-				p->NextToken();
+			default:
+				r.m_pValue = rd.Take(CPropertySchema::ValueSize(r.m_Type), CPropertySchema::ValueAlignment(r.m_Type));
+				break;
+		}
 
-				if (!p->IsToken(_T(":")))
-					goto label_error;
+		if (!rd.OK())
+			return false;
+	}
 
-				p->NextToken();
+	if (bytesconsumed)
+		*bytesconsumed = rd.GetConsumed();
 
-				// if it's a set, then skip it... ostensibly this is the opener
-				if (p->IsToken(_T("property_set")))
-					continue;
+	return true;
+}
 
-				// if we got past the opener and it's not a property, then it's an error
-				if (!p->IsToken(_T("property")))
-					goto label_error;
-			}
-			else
-				goto label_error;
 
-			tstring propname, propid, proptype, propaspect;
+bool CPropertySetView::ParseRecord(const uint8_t *&p, const uint8_t *end, SRecord &r)
+{
+	if ((size_t)(end - p) < (sizeof(BYTE) /*serialization type*/ + sizeof(FOURCHARCODE) /*id*/ + sizeof(BYTE) /*PROPERTY_TYPE*/))
+		return false;
 
-			// read the whole opening tag string
-			if (p->ReadUntil(_T(">"), false, true))
-			{
-				// create a new parser for the attributes
-				q = (genio::IParserT *)genio::IParser::Create(genio::IParser::CHAR_MODE::CM_TCHAR);
-				q->SetSourceData(p->GetCurrentTokenString(), _tcslen(p->GetCurrentTokenString()));
+	IProperty::SERIALIZE_MODE mode = IProperty::SERIALIZE_MODE(*p);
+	if (mode > IProperty::SM_BIN_VERBOSE)
+		return false;
+	p += sizeof(BYTE);
 
-				while (q->NextToken())
-				{
-					if (q->GetCurrentTokenType() != genio::IParser::TOKEN_TYPE::TT_IDENT)
-						goto label_error;
+	memcpy(&r.m_ID, p, sizeof(FOURCHARCODE));
+	p += sizeof(FOURCHARCODE);
 
-					tstring attrib = q->GetCurrentTokenString();
-					q->NextToken();
+	r.m_Type = IProperty::PROPERTY_TYPE(*p);
+	if (r.m_Type >= IProperty::PT_NUMTYPES)
+		return false;
+	p += sizeof(BYTE);
 
-					if (!q->IsToken(_T("=")))
-						goto label_error;
+	r.m_Aspect = IProperty::PA_GENERIC;
+	if (mode >= IProperty::SM_BIN_TERSE)
+	{
+		if (p >= end)
+			return false;
 
-					q->NextToken();
-					if (q->GetCurrentTokenType() != genio::IParser::TOKEN_TYPE::TT_STRING)
-						goto label_error;
+		r.m_Aspect = IProperty::PROPERTY_ASPECT(*p);
+		p += sizeof(BYTE);
+	}
 
-					tstring attrib_val = q->GetCurrentTokenString();
+	r.m_pName = nullptr;
+	if (mode == IProperty::SM_BIN_VERBOSE)
+	{
+		size_t ns = StringSize(p, end);
+		if (!ns)
+			return false;
 
-					if (!_tcsicmp(attrib.c_str(), _T("name")))
-					{
-						propname = q->GetCurrentTokenString();
-					}
-					else if (!_tcsicmp(attrib.c_str(), _T("id")))
-					{
-						propid = q->GetCurrentTokenString();
-					}
-					else if (!_tcsicmp(attrib.c_str(), _T("type")))
-					{
-						proptype = q->GetCurrentTokenString();
-						std::transform(proptype.begin(), proptype.end(), proptype.begin(), toupper);
-					}
-					else if (!_tcsicmp(attrib.c_str(), _T("aspect")))
-					{
-						propaspect = q->GetCurrentTokenString();
-						std::transform(propaspect.begin(), propaspect.end(), propaspect.begin(), toupper);
-					}
-					else
-						goto label_error;
-				}
+		r.m_pName = (const TCHAR *)p;
+		p += ns;
+	}
 
-				q->Release();
-				q = nullptr;
-			}
-			else
-				goto label_error;
+	r.m_pStr = nullptr;
+	if ((r.m_Type == IProperty::PT_STRING) || (r.m_Type == IProperty::PT_ENUM))
+	{
+		size_t ss = StringSize(p, end);
+		if (!ss)
+			return false;
 
-			FOURCHARCODE fcc;
-			uint8_t *pid = (uint8_t *)&fcc;
-			const TCHAR *tid = propid.c_str();
-			for (size_t i = 0; i < 4; i++)
-			{
-				if (*tid == _T('&'))
-				{
-					TCHAR tmp[8], *_tmp = tmp;
-					for (size_t q = 0; (q < 7) && *tid && (*tid != _T(';')); q++)
-					{
-						*(_tmp++) = *(tid++);
-					}
-					*(_tmp++) = *(tid++);
-					*(_tmp++) = _T('\0');
-					_stscanf_s(tmp, _T("&#%hhu;"), &pid[3 - i]);
-				}
-				else
-				{
-					pid[3-i] = (uint8_t)(*(tid++));
-				}
-			}
-			while (!(fcc & 0xff))
-				fcc >>= 8;
+		r.m_pStr = (const TCHAR *)p;
+		if (r.m_Type == IProperty::PT_ENUM)
+			p += ss;
+	}
+
+	r.m_pValue = p;
 
-			props::IProperty *pp = GetPropertyById(fcc);
+	size_t vs = (r.m_Type == IProperty::PT_STRING) ? StringSize(p, end) : CPropertySchema::ValueSize(r.m_Type);
+	if ((size_t)(end - p) < vs)
+		return false;
 
-			if (!pp && !propname.empty())
-				pp = GetPropertyByName(propname.c_str());
+	p += vs;
 
-			if (!pp)
-				pp = CreateProperty(propname.c_str(), fcc);
+	return true;
+}
 
-			if (!pp)
-				goto label_error;
 
-			if (p->ReadUntil(_T("<"), false, true))
-			{
-				tstring v;
-				props::UnescapeString(p->GetCurrentTokenString(), v);
-				pp->SetString(v.c_str());
+IPropertySet *IPropertySet::CreatePropertySet(ALLOCATION_MODE mode)
+{
+	return new CPropertySet(mode);
+}
 
-				if (!_tcsicmp(proptype.c_str(), _T("BOOLEAN")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_BOOLEAN);
-				else if (!_tcsicmp(proptype.c_str(), _T("ENUM")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_ENUM);
-				else if (!_tcsicmp(proptype.c_str(), _T("FLOAT")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_FLOAT);
-				else if (!_tcsicmp(proptype.c_str(), _T("FLOAT_V2")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_FLOAT_V2);
-				else if (!_tcsicmp(proptype.c_str(), _T("FLOAT_V3")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_FLOAT_V3);
-				else if (!_tcsicmp(proptype.c_str(), _T("FLOAT_V4")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_FLOAT_V4);
-				else if (!_tcsicmp(proptype.c_str(), _T("GUID")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_GUID);
-				else if (!_tcsicmp(proptype.c_str(), _T("INT")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_INT);
-				else if (!_tcsicmp(proptype.c_str(), _T("INT_V2")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_INT_V2);
-				else if (!_tcsicmp(proptype.c_str(), _T("INT_V3")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_INT_V3);
-				else if (!_tcsicmp(proptype.c_str(), _T("INT_V4")))
-					pp->ConvertTo(props::IProperty::PROPERTY_TYPE::PT_INT_V4);
-			}
-		}
+void IPropertySet::GetNamePoolStats(SNamePoolStats *stats)
+{
+	if (stats)
+		CNamePool::Get().GetStats(stats);
+}
+
+bool IPropertySet::SerializeBatch(const IPropertySet * const *sets, size_t numsets, IProperty::SERIALIZE_MODE mode, IDataSink *psink)
+{
+	return CBatchSerializer::Write(sets, numsets, mode, psink);
+}
+
+bool IPropertySet::DeserializeBatch(const uint8_t *buf, size_t bufsize, IPropertySet **sets, size_t maxsets, size_t *numsets, size_t *bytesconsumed)
+{
+	return CBatchSerializer::Read(buf, bufsize, sets, maxsets, numsets, bytesconsumed);
+}
+
+bool IPropertySet::SerializeMulti(const IPropertySet * const *sets, size_t numsets, IProperty::SERIALIZE_MODE mode, IDataSink *psink)
+{
+	return CMultiSetSerializer::Write(sets, numsets, mode, psink);
+}
+
+bool IPropertySet::DeserializeMulti(const uint8_t *buf, size_t bufsize, IPropertySet **sets, size_t maxsets, size_t *numsets, size_t numthreads, size_t *bytesconsumed)
+{
+	return CMultiSetSerializer::Read(buf, bufsize, sets, maxsets, numsets, numthreads, bytesconsumed);
+}
+
+IDataBuffer *IDataBuffer::CreateDataBuffer(size_t reserve)
+{
+	return new CDataBuffer(reserve);
+}
+
+IFileSink *IFileSink::CreateFileSink(const TCHAR *filename)
+{
+	FILE *pf = nullptr;
+	if (!filename || _tfopen_s(&pf, filename, _T("wb")) || !pf)
+		return nullptr;
+
+	return new CFileSink(pf);
+}
+
+IPropertyCodec *IPropertyCodec::GetLZCodec()
+{
+	return CLZCodec::Get();
+}
+
+IPropertySetView *IPropertySetView::CreatePropertySetView(const uint8_t *buf, size_t bufsize, size_t *bytesconsumed)
+{
+	CPropertySetView *pview = new CPropertySetView();
+	if (!pview->Parse(buf, bufsize, bytesconsumed))
+	{
+		pview->Release();
+		return nullptr;
 	}
 
-	ret = true;
+	return pview;
+}
 
-// I'm not proud of using a goto, but for the first time in a long time, it makes sense... <shrug>
-label_error:
-	if (p)
+IPropertySetView *IPropertySetView::CreateArchiveView(const uint8_t *buf, size_t bufsize)
+{
+	CPropertyArchiveView *pview = new CPropertyArchiveView();
+	if (!pview->Open(buf, bufsize))
 	{
-		p->Release();
-		p = nullptr;
+		pview->Release();
+		return nullptr;
 	}
 
-	if (q)
+	return pview;
+}
+
+IPropertySetView *IPropertySetView::OpenPropertyArchive(const TCHAR *filename)
+{
+	if (!filename)
+		return nullptr;
+
+	CPropertyArchiveView *pview = new CPropertyArchiveView();
+
+	LARGE_INTEGER sz;
+	pview->m_hFile = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if ((pview->m_hFile != INVALID_HANDLE_VALUE) && GetFileSizeEx(pview->m_hFile, &sz) && (sz.QuadPart > 0) && (uint64_t(sz.QuadPart) <= SIZE_MAX))
 	{
-		q->Release();
-		q = nullptr;
+		pview->m_hMapping = CreateFileMapping(pview->m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (pview->m_hMapping)
+		{
+			const uint8_t *buf = (const uint8_t *)MapViewOfFile(pview->m_hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (buf && pview->Open(buf, size_t(sz.QuadPart)))
+				return pview;
+
+			// Open only keeps the buffer once it's valid, so make sure the destructor can unmap it
+			pview->m_pBuf = buf;
+			if (!buf)
+			{
+				CloseHandle(pview->m_hMapping);
+				pview->m_hMapping = NULL;
+			}
+		}
 	}
 
-	return ret;
+	pview->Release();
+	return nullptr;
 }
 
+IPropertySchema *IPropertySchema::CreatePropertySchema(const IPropertySet *prototype)
+{
+	return new CPropertySchema(prototype);
+}
 
-IPropertySet *IPropertySet::CreatePropertySet()
+IPropertyTable *IPropertyTable::CreatePropertyTable(IPropertySchema *schema)
 {
-	return new CPropertySet();
+	if (!schema)
+		return nullptr;
+
+	return new CPropertyTable((CPropertySchema *)schema);
 }
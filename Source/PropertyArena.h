@@ -0,0 +1,163 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// PropertyArena.h : a slab allocator owned by a property set
+//
+// Small blocks are carved out of large slabs and recycled through per-size free lists;
+// anything too big for a size class goes straight to the heap. Everything carved from
+// the slabs is returned at once by Reset, which is what makes tearing down a set cheap.
+
+#pragma once
+
+
+class CPropertyArena
+{
+protected:
+	enum
+	{
+		SLAB_SIZE = (64 << 10),
+		GRANULE = 16,
+		NUM_CLASSES = 32,						// size classes of GRANULE, 2*GRANULE, ... NUM_CLASSES*GRANULE bytes
+		MAX_CLASS_SIZE = (NUM_CLASSES * GRANULE)
+	};
+
+	struct SFreeBlock
+	{
+		SFreeBlock *next;
+	};
+
+	typedef std::vector<uint8_t *> TSlabArray;
+	TSlabArray m_Slabs;
+
+	uint8_t *m_Cur, *m_End;
+
+	SFreeBlock *m_Free[NUM_CLASSES];
+
+	bool m_Releasing;
+
+	static inline size_t RoundUp(size_t sz) { return (sz + (GRANULE - 1)) & ~(size_t)(GRANULE - 1); }
+
+public:
+	CPropertyArena()
+	{
+		m_Cur = m_End = nullptr;
+		memset(m_Free, 0, sizeof(m_Free));
+		m_Releasing = false;
+	}
+
+	~CPropertyArena()
+	{
+		for (TSlabArray::iterator it = m_Slabs.begin(), last_it = m_Slabs.end(); it != last_it; it++)
+			free(*it);
+	}
+
+	CPropertyArena(const CPropertyArena &) = delete;
+	CPropertyArena &operator =(const CPropertyArena &) = delete;
+
+	/// Allocates sz bytes. The same size must be given back to Free.
+	void *Alloc(size_t sz)
+	{
+		sz = RoundUp(sz ? sz : 1);
+		if (sz > MAX_CLASS_SIZE)
+			return malloc(sz);
+
+		size_t c = (sz / GRANULE) - 1;
+		if (m_Free[c])
+		{
+			SFreeBlock *b = m_Free[c];
+			m_Free[c] = b->next;
+			return b;
+		}
+
+		if ((m_Cur + sz) > m_End)
+		{
+			// whatever is left in the current slab is abandoned until the next Reset
+			uint8_t *slab = (uint8_t *)malloc(SLAB_SIZE);
+			if (!slab)
+				return nullptr;
+
+			m_Slabs.push_back(slab);
+			m_Cur = slab;
+			m_End = slab + SLAB_SIZE;
+		}
+
+		void *ret = m_Cur;
+		m_Cur += sz;
+		return ret;
+	}
+
+	/// Returns a block to the arena; sz must match what was passed to Alloc
+	void Free(void *p, size_t sz)
+	{
+		if (!p)
+			return;
+
+		sz = RoundUp(sz ? sz : 1);
+		if (sz > MAX_CLASS_SIZE)
+		{
+			free(p);
+			return;
+		}
+
+		// slab memory is about to be reclaimed wholesale, so there's no point in threading it onto a free list
+		if (m_Releasing)
+			return;
+
+		size_t c = (sz / GRANULE) - 1;
+		SFreeBlock *b = (SFreeBlock *)p;
+		b->next = m_Free[c];
+		m_Free[c] = b;
+	}
+
+	/// While releasing, Free only hands back heap blocks; call before destroying everything that lives in the arena
+	void BeginRelease()
+	{
+		m_Releasing = true;
+	}
+
+	/// Reclaims every slab block at once. The first slab is kept so the arena can be refilled without going back to the heap.
+	void Reset()
+	{
+		if (!m_Slabs.empty())
+		{
+			for (TSlabArray::iterator it = m_Slabs.begin() + 1, last_it = m_Slabs.end(); it != last_it; it++)
+				free(*it);
+
+			m_Slabs.resize(1);
+			m_Cur = m_Slabs[0];
+			m_End = m_Cur + SLAB_SIZE;
+		}
+
+		memset(m_Free, 0, sizeof(m_Free));
+		m_Releasing = false;
+	}
+};
@@ -0,0 +1,205 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// ValueFormatter.h : writes property values as text, without printf or the locale
+//
+// Numbers go through std::to_chars: integers in decimal and floats in the fewest digits that read
+// back as the same value, so 0.1f is "0.1" rather than "0.100000" and nothing is lost. Every
+// fixed-size value fits in MAX_VALUE_CHARS, so callers format once into a stack buffer instead of
+// measuring first.
+
+#pragma once
+
+
+class CValueFormatter
+{
+protected:
+	template <typename T> static size_t FormatChars(T v, TCHAR *buf)
+	{
+		char a[MAX_NUMBER_CHARS];
+		std::to_chars_result r = std::to_chars(a, a + sizeof(a), v);
+
+		size_t n = r.ptr - a;
+		for (size_t i = 0; i < n; i++)
+			buf[i] = (TCHAR)a[i];
+
+		return n;
+	}
+
+	static size_t FormatHex(uint32_t v, size_t digits, TCHAR *buf)
+	{
+		static const TCHAR hex[] = _T("0123456789ABCDEF");
+
+		for (size_t i = digits; i > 0; i--, v >>= 4)
+			buf[i - 1] = hex[v & 0xF];
+
+		return digits;
+	}
+
+public:
+	enum
+	{
+		// "-9223372036854775808" is the longest integer, and longer than any float
+		MAX_NUMBER_CHARS = 24,
+
+		// a 4x4 matrix: sixteen numbers, fifteen commas and a terminator
+		MAX_VALUE_CHARS = (16 * (MAX_NUMBER_CHARS + 1)) + 1
+	};
+
+	// each Format writes at buf, without a terminator, and returns the number of characters
+	static size_t Format(int64_t v, TCHAR *buf)
+	{
+		return FormatChars(v, buf);
+	}
+
+	static size_t Format(float v, TCHAR *buf)
+	{
+		return FormatChars(v, buf);
+	}
+
+	// n values separated by commas
+	template <typename T> static size_t FormatList(const T *v, size_t n, TCHAR *buf)
+	{
+		size_t len = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			if (i)
+				buf[len++] = _T(',');
+
+			len += Format(v[i], buf + len);
+		}
+
+		return len;
+	}
+
+	// {XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX}
+	static size_t FormatGUID(const GUID &g, TCHAR *buf)
+	{
+		size_t len = 0;
+		buf[len++] = _T('{');
+		len += FormatHex(g.Data1, 8, buf + len);
+		buf[len++] = _T('-');
+		len += FormatHex(g.Data2, 4, buf + len);
+		buf[len++] = _T('-');
+		len += FormatHex(g.Data3, 4, buf + len);
+		buf[len++] = _T('-');
+		for (size_t i = 0; i < 8; i++)
+		{
+			if (i == 2)
+				buf[len++] = _T('-');
+
+			len += FormatHex(g.Data4[i], 2, buf + len);
+		}
+		buf[len++] = _T('}');
+
+		return len;
+	}
+
+	// formats a fixed-size value of the given type, found at pval, into a buffer of MAX_VALUE_CHARS and terminates it;
+	// strings, enums and booleans (whose text depends on the aspect) are left to the caller and come back empty
+	static size_t FormatValue(props::IProperty::PROPERTY_TYPE type, const void *pval, TCHAR *buf)
+	{
+		size_t len = 0;
+
+		switch (type)
+		{
+			case props::IProperty::PROPERTY_TYPE::PT_INT:
+				len = Format(*(const int64_t *)pval, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_INT_V2:
+				len = FormatList(((const props::TVec2I *)pval)->v, 2, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_INT_V3:
+				len = FormatList(((const props::TVec3I *)pval)->v, 3, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_INT_V4:
+				len = FormatList(((const props::TVec4I *)pval)->v, 4, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT:
+				len = Format(*(const float *)pval, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V2:
+				len = FormatList(((const props::TVec2F *)pval)->v, 2, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V3:
+				len = FormatList(((const props::TVec3F *)pval)->v, 3, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_V4:
+				len = FormatList(((const props::TVec4F *)pval)->v, 4, buf);
+				break;
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_MAT3X3:
+			{
+				const props::TMat3x3F *m = (const props::TMat3x3F *)pval;
+				for (size_t row = 0; row < 3; row++)
+				{
+					if (row)
+						buf[len++] = _T(',');
+
+					len += FormatList(m->m[row].v, 3, buf + len);
+				}
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_FLOAT_MAT4X4:
+			{
+				const props::TMat4x4F *m = (const props::TMat4x4F *)pval;
+				for (size_t row = 0; row < 4; row++)
+				{
+					if (row)
+						buf[len++] = _T(',');
+
+					len += FormatList(m->m[row].v, 4, buf + len);
+				}
+				break;
+			}
+
+			case props::IProperty::PROPERTY_TYPE::PT_GUID:
+				len = FormatGUID(*(const GUID *)pval, buf);
+				break;
+
+			default:
+				break;
+		}
+
+		buf[len] = _T('\0');
+
+		return len;
+	}
+};
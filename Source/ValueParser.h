@@ -0,0 +1,277 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// ValueParser.h : reads property values from text
+//
+// STextSpan is a run of characters within a larger document, such as an XML or JSON value, or a
+// whole string property, and CValueParser turns one into a typed value. Lists of numbers may be
+// separated by commas and bracketed, so a JSON array parses the same as the comma-delimited text
+// AsString produces. Numbers are read with from_chars, so the locale doesn't change how they're
+// read, and nothing past the end of the span is looked at.
+//
+// Every parse sets its whole output, with anything missing or malformed as 0, and returns false
+// if the text wasn't exactly a value of the type asked for.
+
+#pragma once
+
+
+// a run of characters in the source text; it is not terminated
+struct STextSpan
+{
+	const TCHAR *p;
+	size_t len;
+
+	void Clear()
+	{
+		p = nullptr;
+		len = 0;
+	}
+
+	// case-insensitive comparison against a terminated string
+	bool Is(const TCHAR *s) const
+	{
+		size_t slen = _tcslen(s);
+		return ((len == slen) && !_tcsnicmp(p, s, len));
+	}
+};
+
+
+class CValueParser
+{
+protected:
+	// longer than any number AsString writes, and than any a float or int64 needs to be exact
+	static const size_t MAX_NUMBER_CHARS = 64;
+
+	// ASCII whitespace only; _istspace is a call per character, and depends on the locale
+	static bool IsSpace(TCHAR c)
+	{
+		return ((c == _T(' ')) || ((c >= _T('\t')) && (c <= _T('\r'))));
+	}
+
+	static bool IsSeparator(TCHAR c)
+	{
+		return (IsSpace(c) || (c == _T(',')) || (c == _T('[')) || (c == _T(']')));
+	}
+
+	// from_chars wants narrow characters and no leading plus; false if [c, e) can't be a number
+	static bool Narrow(const TCHAR *c, const TCHAR *e, char *buf, size_t &len)
+	{
+		if (((e - c) > 1) && (*c == _T('+')) && (c[1] != _T('-')))
+			c++;
+
+		if ((c == e) || ((size_t)(e - c) > MAX_NUMBER_CHARS))
+			return false;
+
+		for (len = 0; c < e; c++)
+		{
+			if ((unsigned)*c > 0x7F)
+				return false;
+
+			buf[len++] = (char)*c;
+		}
+
+		return true;
+	}
+
+public:
+	// reads the number that is all of [c, e); v is 0 if there isn't one
+	static bool ParseNumber(const TCHAR *c, const TCHAR *e, int64_t &v)
+	{
+		v = 0;
+
+		// plain integers are read straight from the text, without narrowing it first
+		const TCHAR *d = c;
+		bool neg = false;
+		if ((d < e) && ((*d == _T('-')) || (*d == _T('+'))))
+			neg = (*(d++) == _T('-'));
+
+		const TCHAR *digits = d;
+		uint64_t u = 0;
+		for (; (d < e) && (*d >= _T('0')) && (*d <= _T('9')) && (u < (UINT64_MAX / 10)); d++)
+			u = (u * 10) + (uint64_t)(*d - _T('0'));
+
+		if ((d == e) && (d != digits) && (u <= (neg ? ((uint64_t)INT64_MAX + 1) : (uint64_t)INT64_MAX)))
+		{
+			v = neg ? (int64_t)(0 - u) : (int64_t)u;
+			return true;
+		}
+
+		// a fraction or exponent is truncated toward zero, the same as converting from a float
+		char buf[MAX_NUMBER_CHARS];
+		size_t len;
+		if (!Narrow(c, e, buf, len))
+			return false;
+
+		double f = 0.0;
+		::std::from_chars_result r = ::std::from_chars(buf, buf + len, f);
+		if ((r.ec != ::std::errc()) || (r.ptr != (buf + len)) || !(fabs(f) < 9.2e18))
+			return false;
+
+		v = (int64_t)f;
+		return true;
+	}
+
+	// reads the number that is all of [c, e); v is 0 if there isn't one, or infinity or 0 if it's out of range
+	static bool ParseNumber(const TCHAR *c, const TCHAR *e, float &v)
+	{
+		v = 0.0f;
+
+		char buf[MAX_NUMBER_CHARS];
+		size_t len;
+		if (!Narrow(c, e, buf, len))
+			return false;
+
+		::std::from_chars_result r = ::std::from_chars(buf, buf + len, v);
+		if (r.ptr != (buf + len))
+		{
+			v = 0.0f;
+			return false;
+		}
+
+		if (r.ec == ::std::errc::result_out_of_range)
+		{
+			// from_chars leaves v alone when it's out of range; going through a double gives it the right magnitude
+			double d = 0.0;
+			::std::from_chars(buf, buf + len, d);
+			v = (float)d;
+			return false;
+		}
+
+		return (r.ec == ::std::errc());
+	}
+
+	// reads n numbers separated by commas, whitespace or brackets into v
+	template <typename T> static bool ParseList(const STextSpan &s, T *v, size_t n)
+	{
+		bool ok = true;
+
+		const TCHAR *c = s.p, *end = s.p + s.len;
+		for (size_t i = 0; i < n; i++)
+		{
+			while ((c < end) && IsSeparator(*c))
+				c++;
+
+			const TCHAR *e = c;
+			while ((e < end) && !IsSeparator(*e))
+				e++;
+
+			ok &= ParseNumber(c, e, v[i]);
+			c = e;
+		}
+
+		while ((c < end) && IsSeparator(*c))
+			c++;
+
+		return ok && (c == end);
+	}
+
+	static bool ParseInts(const STextSpan &s, int64_t *v, size_t n)
+	{
+		return ParseList(s, v, n);
+	}
+
+	static bool ParseFloats(const STextSpan &s, float *v, size_t n)
+	{
+		return ParseList(s, v, n);
+	}
+
+	// nine floats, a row at a time
+	static bool ParseMatrix(const STextSpan &s, props::TMat3x3F &m)
+	{
+		float f[9];
+		bool ok = ParseFloats(s, f, 9);
+		for (size_t row = 0; row < 3; row++)
+			m.m[row] = props::TVec3F(f[row * 3], f[(row * 3) + 1], f[(row * 3) + 2]);
+
+		return ok;
+	}
+
+	// sixteen floats, a row at a time
+	static bool ParseMatrix(const STextSpan &s, props::TMat4x4F &m)
+	{
+		float f[16];
+		bool ok = ParseFloats(s, f, 16);
+		for (size_t row = 0; row < 4; row++)
+			m.m[row] = props::TVec4F(f[row * 4], f[(row * 4) + 1], f[(row * 4) + 2], f[(row * 4) + 3]);
+
+		return ok;
+	}
+
+	// accepts every pair of words a boolean aspect can be written with; anything else is false
+	static bool ParseBool(const STextSpan &s, bool &b)
+	{
+		b = (s.Is(_T("1")) || s.Is(_T("true")) || s.Is(_T("yes")) || s.Is(_T("on")) || s.Is(_T("enabled")));
+
+		return (b || s.Is(_T("0")) || s.Is(_T("false")) || s.Is(_T("no")) || s.Is(_T("off")) || s.Is(_T("disabled")));
+	}
+
+	// reads {XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX}, taking the hex digits in order and skipping the punctuation
+	static bool ParseGUID(const STextSpan &s, GUID &g)
+	{
+		bool ok = true;
+
+		uint8_t nib[32] = {0};
+		size_t n = 0;
+		for (const TCHAR *c = s.p, *end = s.p + s.len; c < end; c++)
+		{
+			uint8_t d;
+			if ((*c >= _T('0')) && (*c <= _T('9')))
+				d = (uint8_t)(*c - _T('0'));
+			else if ((*c >= _T('a')) && (*c <= _T('f')))
+				d = (uint8_t)(*c - _T('a') + 10);
+			else if ((*c >= _T('A')) && (*c <= _T('F')))
+				d = (uint8_t)(*c - _T('A') + 10);
+			else
+			{
+				ok &= ((*c == _T('{')) || (*c == _T('}')) || (*c == _T('-')) || IsSpace(*c));
+				continue;
+			}
+
+			if (n < 32)
+				nib[n] = d;
+			n++;
+		}
+
+		memset(&g, 0, sizeof(GUID));
+
+		for (size_t i = 0; i < 8; i++)
+			g.Data1 = (g.Data1 << 4) | nib[i];
+		for (size_t i = 8; i < 12; i++)
+			g.Data2 = (uint16_t)((g.Data2 << 4) | nib[i]);
+		for (size_t i = 12; i < 16; i++)
+			g.Data3 = (uint16_t)((g.Data3 << 4) | nib[i]);
+		for (size_t i = 0; i < 8; i++)
+			g.Data4[i] = (uint8_t)((nib[16 + (i * 2)] << 4) | nib[17 + (i * 2)]);
+
+		return ok && (n == 32);
+	}
+};
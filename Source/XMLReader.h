@@ -0,0 +1,294 @@
+/*
+PowerProps Library Source File
+
+Copyright © 2009-2026, Keelan Stuart. All rights reserved.
+
+PowerProps is a generic property library which one can use to maintain
+easily discoverable data in a number of types, as well as convert that
+data to other formats and de/serialize in multiple modes
+
+PowerProps is free software; you can redistribute it and/or modify it under
+the terms of the MIT License:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// XMLReader.h : a single-pass reader for the powerprops XML dialect
+//
+// The reader walks the source text once and never copies it; each property tag comes back as spans
+// pointing into the source for its attributes and value. Only text that needs unescaping, or a
+// terminator, is copied, into strings the caller reuses from one property to the next.
+//
+// Values of every type but strings and enums are handed to CValueParser straight from the source;
+// each is followed there by the '<' of its closing tag.
+
+#pragma once
+
+
+class CXMLReader
+{
+protected:
+	const TCHAR *m_Pos, *m_End;
+
+	void SkipSpace()
+	{
+		while ((m_Pos < m_End) && _istspace(*m_Pos))
+			m_Pos++;
+	}
+
+	// moves past the next occurrence of c; false if there isn't one
+	bool SkipPast(TCHAR c)
+	{
+		while ((m_Pos < m_End) && (*m_Pos != c))
+			m_Pos++;
+
+		if (m_Pos == m_End)
+			return false;
+
+		m_Pos++;
+		return true;
+	}
+
+	bool ReadIdent(STextSpan &ident)
+	{
+		ident.p = m_Pos;
+		while ((m_Pos < m_End) && (_istalnum(*m_Pos) || (*m_Pos == _T('_'))))
+			m_Pos++;
+
+		ident.len = m_Pos - ident.p;
+		return (ident.len > 0);
+	}
+
+	bool Expect(const TCHAR *s)
+	{
+		size_t len = _tcslen(s);
+		if (((size_t)(m_End - m_Pos) < len) || memcmp(m_Pos, s, len * sizeof(TCHAR)))
+			return false;
+
+		m_Pos += len;
+		return true;
+	}
+
+public:
+	// the attributes and value of one <powerprops:property> element; anything not present is empty
+	struct SProperty
+	{
+		STextSpan id, name, type, aspect;
+		STextSpan value;
+	};
+
+	enum RESULT
+	{
+		R_PROPERTY = 0,
+		R_END,
+		R_ERROR
+	};
+
+	CXMLReader(const TCHAR *src, size_t len)
+	{
+		m_Pos = src;
+		m_End = src + len;
+	}
+
+	// finds the next property element, skipping the set's own tags, closing tags, comments and declarations
+	RESULT Next(SProperty &prop)
+	{
+		while (SkipPast(_T('<')))
+		{
+			SkipSpace();
+
+			if ((m_Pos < m_End) && ((*m_Pos == _T('/')) || (*m_Pos == _T('!')) || (*m_Pos == _T('?'))))
+			{
+				if (!SkipPast(_T('>')))
+					return R_ERROR;
+
+				continue;
+			}
+
+			STextSpan tag;
+			if (!Expect(_T("powerprops:")) || !ReadIdent(tag))
+				return R_ERROR;
+
+			if (tag.len == 12 && !memcmp(tag.p, _T("property_set"), 12 * sizeof(TCHAR)))
+			{
+				if (!SkipPast(_T('>')))
+					return R_ERROR;
+
+				continue;
+			}
+
+			if (tag.len != 8 || memcmp(tag.p, _T("property"), 8 * sizeof(TCHAR)))
+				return R_ERROR;
+
+			prop.id.Clear();
+			prop.name.Clear();
+			prop.type.Clear();
+			prop.aspect.Clear();
+
+			while (true)
+			{
+				SkipSpace();
+
+				if (m_Pos == m_End)
+					return R_ERROR;
+
+				if (*m_Pos == _T('>'))
+				{
+					m_Pos++;
+					break;
+				}
+
+				STextSpan attrib;
+				if (!ReadIdent(attrib))
+					return R_ERROR;
+
+				SkipSpace();
+				if (!Expect(_T("=")))
+					return R_ERROR;
+
+				SkipSpace();
+				if ((m_Pos == m_End) || ((*m_Pos != _T('\"')) && (*m_Pos != _T('\''))))
+					return R_ERROR;
+
+				TCHAR quote = *(m_Pos++);
+				STextSpan val;
+				val.p = m_Pos;
+				if (!SkipPast(quote))
+					return R_ERROR;
+
+				val.len = m_Pos - val.p - 1;
+
+				if (attrib.Is(_T("id")))
+					prop.id = val;
+				else if (attrib.Is(_T("name")))
+					prop.name = val;
+				else if (attrib.Is(_T("type")))
+					prop.type = val;
+				else if (attrib.Is(_T("aspect")))
+					prop.aspect = val;
+				else
+					return R_ERROR;
+			}
+
+			// the value runs up to the closing tag, which the next call skips
+			prop.value.p = m_Pos;
+			if (!SkipPast(_T('<')))
+				return R_ERROR;
+
+			m_Pos--;
+			prop.value.len = m_Pos - prop.value.p;
+
+			return R_PROPERTY;
+		}
+
+		return R_END;
+	}
+
+	// copies a span to a terminated string, replacing the entities EscapeString produces as well as numeric ones
+	static void Unescape(const STextSpan &s, tstring &out)
+	{
+		out.clear();
+
+		const TCHAR *c = s.p, *end = s.p + s.len;
+		while (c < end)
+		{
+			// copy everything up to the next entity at once
+			const TCHAR *amp = c;
+			while ((amp < end) && (*amp != _T('&')))
+				amp++;
+
+			out.append(c, amp - c);
+			c = amp;
+			if (c == end)
+				break;
+
+			const TCHAR *semi = c;
+			while ((semi < end) && (semi - c < 12) && (*semi != _T(';')))
+				semi++;
+
+			STextSpan ent = {c + 1, (size_t)(semi - c - 1)};
+			if ((semi == end) || (*semi != _T(';')))
+			{
+				out += *(c++);
+				continue;
+			}
+
+			if (ent.Is(_T("lt")))
+				out += _T('<');
+			else if (ent.Is(_T("gt")))
+				out += _T('>');
+			else if (ent.Is(_T("amp")))
+				out += _T('&');
+			else if (ent.Is(_T("quot")))
+				out += _T('\"');
+			else if (ent.Is(_T("apos")))
+				out += _T('\'');
+			else if ((ent.len > 1) && (*ent.p == _T('#')))
+			{
+				uint32_t v = 0;
+				for (size_t i = 1; i < ent.len; i++)
+				{
+					if (!_istdigit(ent.p[i]))
+					{
+						v = UINT32_MAX;
+						break;
+					}
+
+					v = (v * 10) + (ent.p[i] - _T('0'));
+				}
+
+				if (v > 0xFFFF)
+				{
+					out += *(c++);
+					continue;
+				}
+
+				out += (TCHAR)v;
+			}
+			else
+			{
+				out += *(c++);
+				continue;
+			}
+
+			c = semi + 1;
+		}
+	}
+
+	// the id attribute holds up to four characters, most significant first, with any that aren't alphanumeric
+	// written as numeric entities; scratch is only there so it can be reused
+	static bool DecodeID(const STextSpan &s, tstring &scratch, props::FOURCHARCODE &fcc)
+	{
+		Unescape(s, scratch);
+		if (scratch.length() > 4)
+			return false;
+
+		fcc = 0;
+		for (TCHAR c : scratch)
+		{
+			if ((unsigned)c > 0xFF)
+				return false;
+
+			fcc = (fcc << 8) | (uint8_t)c;
+		}
+
+		return true;
+	}
+};
@@ -46,6 +46,7 @@ SOFTWARE.
 #define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
 
 #include <stdint.h>
+#include <limits.h>
 #include <windows.h>
 #include <malloc.h>
 #include <memory.h>
@@ -55,6 +56,14 @@ SOFTWARE.
 #include <deque>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <string_view>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <thread>
+#include <charconv>
+#include <cmath>
 #include <set>
 #include <algorithm>
 #include <assert.h>